@@ -7,6 +7,38 @@
 #include <cmath>    // Para funções matemáticas
 #include <cstdlib>  // Para funções gerais (como rand)
 #include <ctime>    // Para funções de tempo
+#include <cstddef>  // Para offsetof
+#include <cstdint>  // Para inteiros de tamanho fixo
+#include <cstring>  // Para memcmp/memcpy
+#include <vector>   // Para listas dinâmicas
+#include <algorithm> // Para std::max/std::swap
+#include <thread>   // Para dormir enquanto espera o próximo frame
+#include <chrono>   // Para durações do sleep
+#include <fstream>  // Para ler o arquivo da fonte
+#include <unordered_map> // Para o cache de textos fixos
+#include <atomic>   // Para a distribuição de blocos do rasterizador em software
+#include <mutex>    // Para sincronizar as threads do rasterizador em software
+#include <condition_variable> // Para acordar as threads do rasterizador a cada frame
+#include <deque>    // Para a fila de imagens da captura
+#include <functional> // Para a entrega das leituras assíncronas
+#include <cstdio>   // Para escrever o vídeo (arquivo ou pipe)
+#include <csignal>  // Para ignorar o SIGPIPE quando o leitor do vídeo fecha o pipe
+#ifdef _WIN32
+#include <io.h>     // Para duplicar a saída padrão do vídeo
+#include <fcntl.h>  // Para a saída padrão em modo binário
+#else
+#include <unistd.h> // Para duplicar a saída padrão do vídeo
+#endif
+
+// Instruções SIMD do rasterizador em software (escolhidas na compilação; sem elas fica o laço escalar)
+#if defined(__AVX2__)
+#include <immintrin.h> // AVX2: 8 pixels por vez, com gather dos texels
+#define RASTERIZADOR_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h> // SSE2: 4 pixels por vez (presente em todo x86-64)
+#define RASTERIZADOR_SSE2 1
+#endif
 
 using namespace std;
 
@@ -50,13 +82,199 @@ struct Sprite
     GLuint idTextura;  // ID da textura OpenGL
     vec3 posicao;      // Posição no espaço 3D (x,y,z)
     vec3 dimensoes;    // Escala (largura, altura, profundidade)
-    float angulo;      // Rotação
+    float angulo;      // Rotação em graus (anti-horário), em torno da âncora
     float velocidade;  // Velocidade de movimento
-    int numAnimacoes;  // Número de animações disponíveis
-    int numQuadros;    // Número de quadros por animação
-    int quadroAtual;   // Quadro atual da animação
-    int animacaoAtual; // Animação atual
-    float ds, dt;      // Deslocamento de textura (para animação)
+    int numAnimacoes = 1;          // Linhas da folha de sprites (uma animação por linha)
+    int numQuadros = 1;            // Colunas da folha de sprites (quadros por animação)
+    int animacaoAtual = 0;         // Linha tocada
+    float quadrosPorSegundo = 0.0f; // Velocidade da animação (o quadro é calculado na GPU)
+    float inicioAnimacao = 0.0f;   // Instante (tempo.x) em que a animação atual começou
+    vec4 uvAtlas = vec4(0.0f, 0.0f, 1.0f, 1.0f); // Retângulo UV na textura (x, y, largura, altura)
+    int entradaAtlas = -1;                       // Entrada no atlas de sprites (-1 = textura própria)
+    vec2 fatorParallax = vec2(0.0f);             // Quanto a textura rola por unidade de distância (RECURSO_ROLAGEM)
+    bool translucido = false;                    // Tem alpha parcial: vai para o passe com blending
+    vec2 ancora = vec2(0.5f);                    // Ponto do quadrado (0 a 1) que fica em 'posicao' e serve de eixo da rotação
+    vec4 tingimento = vec4(1.0f);                // Cor multiplicada pela textura (desenho pela fila)
+    int linhaPaleta = 0;                         // Variante de cor: linha da paleta em texturas indexadas (0 = original)
+};
+
+// Dados por instância enviados à GPU no desenho instanciado dos inimigos
+struct DadosInstancia
+{
+    vec3 posicao;   // Posição no espaço 3D (x,y,z)
+    vec2 escala;    // Largura e altura
+    vec2 offsetTex; // Fator de parallax (RECURSO_ROLAGEM)
+    vec4 uvAtlas;   // Retângulo UV do sprite no atlas
+    vec4 folhaAnimacao;   // Quadros, animações, animação atual e quadros por segundo (RECURSO_UV_ANIMADO)
+    float inicioAnimacao; // Instante em que a animação começou
+    float angulo;         // Rotação em graus
+    vec2 ancora;          // Eixo da rotação dentro do quadrado
+    u8vec4 tingimento;    // Cor de tingimento RGBA (normalizada na GPU)
+    uint8_t linhaPaleta;  // Linha da paleta (variante de cor) nas texturas indexadas
+};
+
+// Vértice do texto do HUD (6 por caractere)
+struct VerticeTexto
+{
+    vec2 posicao; // Posição no mundo do jogo
+    vec2 uv;      // Coordenada no atlas da fonte
+    vec4 cor;     // Cor RGBA do texto
+};
+
+// Texto já montado em quads, relativo à linha de base e no tamanho do atlas
+struct TextoPreparado
+{
+    vector<VerticeTexto> vertices; // Quads dos caracteres (cor branca; a cor vem na cópia)
+    float largura = 0.0f;          // Largura da linha mais longa, no tamanho do atlas
+};
+
+// Camadas de desenho, da mais ao fundo para a mais à frente
+enum CamadaRender
+{
+    CAMADA_FUNDO,    // Pista
+    CAMADA_INIMIGOS, // Carros inimigos
+    CAMADA_JOGADOR,  // Carro do jogador
+    CAMADA_INTERFACE // HUD e menus
+};
+
+// Comando de desenho compacto: a chave define a ordem, o índice aponta para os dados
+struct ComandoRender
+{
+    uint64_t chave;  // Layout depende do passe, ver montarChaveRender
+    uint32_t indice; // Posição dos dados em FilaRender::instancias/texturas
+};
+
+// Fila de desenho do frame: preenchida pela simulação, ordenada e enviada à GPU de uma vez
+struct FilaRender
+{
+    vector<ComandoRender> comandos;    // Comandos na ordem em que foram enfileirados
+    vector<ComandoRender> auxiliar;    // Apoio do radix sort
+    vector<DadosInstancia> instancias; // Dados de instância de cada comando
+    vector<GLuint> texturas;           // Textura de cada comando
+};
+
+// Sprite empacotado no atlas de texturas
+struct EntradaAtlas
+{
+    string caminho;            // Arquivo de origem
+    int x, y, largura, altura; // Retângulo em pixels dentro do atlas (sem a borda)
+    vec4 uv;                   // Mesmo retângulo em coordenadas de textura
+    bool translucida;          // Tem pixels com alpha parcial (não basta recortar)
+};
+
+// Programa já vinculado, no formato do driver (glGetProgramBinary)
+struct BinarioPrograma
+{
+    GLenum formato = 0;
+    vector<char> dados;
+};
+
+// Atlas com vários sprites em uma única textura
+struct AtlasTexturas
+{
+    GLuint idTextura = 0;          // Textura OpenGL do atlas
+    int linhasPaleta = 1;          // Variantes de cor disponíveis (1 se o atlas não for indexado)
+    int largura = 0, altura = 0;   // Dimensões do atlas
+    vector<EntradaAtlas> entradas; // Sprites empacotados
+};
+
+// Segmento do horizonte (skyline) usado pelo empacotador do atlas
+struct NoSkyline
+{
+    int x, y;    // Início do segmento e altura ocupada até ele
+    int largura; // Largura do segmento
+};
+
+// Empacotador skyline bottom-left: mantém o contorno superior da área ocupada
+class EmpacotadorSkyline
+{
+public:
+    // Reinicia o empacotador para uma área vazia
+    void iniciar(int larguraArea, int alturaArea)
+    {
+        largura = larguraArea;
+        altura = alturaArea;
+        areaUsada = 0;
+        nos.clear();
+        nos.push_back({0, 0, larguraArea});
+    }
+
+    // Encontra a posição mais baixa onde o retângulo cabe; retorna false se não couber
+    bool inserir(int larguraRet, int alturaRet, int &x, int &y)
+    {
+        int melhorIndice = -1, melhorTopo = altura + 1, melhorLargura = largura + 1;
+        for (size_t i = 0; i < nos.size(); i++)
+        {
+            int yCandidato = ajustar((int)i, larguraRet, alturaRet);
+            if (yCandidato < 0)
+                continue;
+            int topo = yCandidato + alturaRet;
+            if (topo < melhorTopo || (topo == melhorTopo && nos[i].largura < melhorLargura))
+            {
+                melhorIndice = (int)i;
+                melhorTopo = topo;
+                melhorLargura = nos[i].largura;
+                x = nos[i].x;
+                y = yCandidato;
+            }
+        }
+        if (melhorIndice < 0)
+            return false;
+
+        adicionarNivel(melhorIndice, x, y, larguraRet, alturaRet);
+        areaUsada += larguraRet * alturaRet;
+        return true;
+    }
+
+    int areaUsada = 0; // Soma das áreas inseridas
+
+private:
+    vector<NoSkyline> nos;
+    int largura = 0, altura = 0;
+
+    // Altura em que o retângulo apoiaria começando no nó indicado (-1 se não couber)
+    int ajustar(int indice, int larguraRet, int alturaRet) const
+    {
+        if (nos[indice].x + larguraRet > largura)
+            return -1;
+        int y = 0, restante = larguraRet;
+        for (int i = indice; restante > 0; i++)
+        {
+            y = std::max(y, nos[i].y);
+            if (y + alturaRet > altura)
+                return -1;
+            restante -= nos[i].largura;
+        }
+        return y;
+    }
+
+    // Sobe o horizonte sobre o retângulo inserido e junta segmentos de mesma altura
+    void adicionarNivel(int indice, int x, int y, int larguraRet, int alturaRet)
+    {
+        nos.insert(nos.begin() + indice, {x, y + alturaRet, larguraRet});
+        for (size_t i = indice + 1; i < nos.size(); i++)
+        {
+            int fimAnterior = nos[i - 1].x + nos[i - 1].largura;
+            if (nos[i].x >= fimAnterior)
+                break;
+            int encolher = fimAnterior - nos[i].x;
+            nos[i].x += encolher;
+            nos[i].largura -= encolher;
+            if (nos[i].largura > 0)
+                break;
+            nos.erase(nos.begin() + i);
+            i--;
+        }
+        for (size_t i = 0; i + 1 < nos.size(); i++)
+        {
+            if (nos[i].y == nos[i + 1].y)
+            {
+                nos[i].largura += nos[i + 1].largura;
+                nos.erase(nos.begin() + i + 1);
+                i--;
+            }
+        }
+    }
 };
 
 // Estrutura para botões no menu
@@ -68,488 +286,4579 @@ struct Botao
     vec3 cor;     // Cor RGB
 };
 
-// classes de funções (declarações antes da implementação)
-void tecladoCallbackMenu(GLFWwindow *janela, int tecla, int scancode, int acao, int modo);
-void mouseCallbackMenu(GLFWwindow *janela, int botao, int acao, int mods);
-int configurarShader();
-int configurarSprite(int numAnimacoes, int numQuadros, float &ds, float &dt);
-int carregarTextura(string caminhoArquivo);
-void drawSprite(GLuint idShader, Sprite sprite, bool usarCorSolida = false);
-bool verificarColisao(const Sprite &a, const Sprite &b);
-void renderizarMenu(GLuint idShader);
-bool mouseSobreBotao(vec2 posicaoMouse, Botao botao);
+// Cópia do estado OpenGL já enviado ao driver, usada para descartar chamadas redundantes
+const int MAX_UNIDADES_TEXTURA = 16;
+struct CacheEstadoGL
+{
+    GLuint programa = 0;                           // glUseProgram
+    GLuint vao = 0;                                // glBindVertexArray
+    GLuint unidadeAtiva = 0;                       // glActiveTexture (índice da unidade)
+    GLuint texturas[MAX_UNIDADES_TEXTURA] = {};    // GL_TEXTURE_2D vinculada em cada unidade
+    bool blend = false;                            // GL_BLEND
+    GLenum blendOrigem = GL_ONE;                   // glBlendFunc (origem)
+    GLenum blendDestino = GL_ZERO;                 // glBlendFunc (destino)
+    bool depthTest = false;                        // GL_DEPTH_TEST
+    GLenum funcaoDepth = GL_LESS;                  // glDepthFunc
+    bool mascaraDepth = true;                      // glDepthMask
+    int chamadasEmitidas = 0;                      // Chamadas repassadas ao driver no frame
+    int chamadasEvitadas = 0;                      // Chamadas descartadas por não mudarem nada
+};
+CacheEstadoGL estadoGL;
 
-// Constantes de configuração do jogo
-const GLuint LARGURA = 800, ALTURA = 600; // Dimensões da janela
+// Ativa um programa de shader
+void usarPrograma(GLuint programa)
+{
+    if (estadoGL.programa == programa)
+    {
+        estadoGL.chamadasEvitadas++;
+        return;
+    }
+    glUseProgram(programa);
+    estadoGL.programa = programa;
+    estadoGL.chamadasEmitidas++;
+}
 
-// Configurações de dificuldade e gameplay
-const int NUM_TEXTURAS_CARROS = 4;              // Número de texturas diferentes para carros inimigos
-const float VELOCIDADE_INIMIGO_BASE = 2.0f;     // Velocidade inicial dos inimigos
-const float VELOCIDADE_INIMIGO_MAXIMA = 8.0f;   // Velocidade máxima dos inimigos
-const float TAXA_AUMENTO_DIFICULDADE = 0.6f;    // Quanto aumenta a velocidade por segundo
-const float INTERVALO_DIFICULDADE = 8.0f;      // Intervalo para aumentar dificuldade
-const int MAX_INIMIGOS = 1000;                   // Número máximo de inimigos na tela
-const float INTERVALO_APARICAO_INIMIGOS = 0.2f; // Intervalo entre aparecer novos inimigos
+// Vincula um Vertex Array Object
+void vincularVAO(GLuint vao)
+{
+    if (estadoGL.vao == vao)
+    {
+        estadoGL.chamadasEvitadas++;
+        return;
+    }
+    glBindVertexArray(vao);
+    estadoGL.vao = vao;
+    estadoGL.chamadasEmitidas++;
+}
 
-// Configurações de interface do menu
-const vec2 TAMANHO_BOTAO = vec2(200, 60);              // Tamanho padrão dos botões
-const float OFFSET_Y_BOTAO = 50.0f;                    // Espaçamento vertical entre botões
-const vec3 COR_BOTAO = vec3(0.2f, 0.3f, 0.8f);         // Cor base dos botões
-const vec3 COR_HOVER_INICIAR = vec3(0.0f, 1.0f, 0.5f); // Cor quando mouse está sobre o botão Iniciar
-const vec3 COR_HOVER_SAIR = vec3(1.0f, 0.5f, 0.5f);    // Cor quando mouse está sobre o botão Sair
+// Vincula uma textura 2D na unidade indicada (troca a unidade ativa só se precisar)
+void vincularTextura(GLuint unidade, GLuint textura)
+{
+    assert(unidade < MAX_UNIDADES_TEXTURA);
+    if (estadoGL.texturas[unidade] == textura)
+    {
+        estadoGL.chamadasEvitadas++;
+        return;
+    }
+    if (estadoGL.unidadeAtiva != unidade)
+    {
+        glActiveTexture(GL_TEXTURE0 + unidade);
+        estadoGL.unidadeAtiva = unidade;
+        estadoGL.chamadasEmitidas++;
+    }
+    glBindTexture(GL_TEXTURE_2D, textura);
+    estadoGL.texturas[unidade] = textura;
+    estadoGL.chamadasEmitidas++;
+}
 
-// Array de botões do menu
-Botao botoes[] = {                                                                  
-    {vec2(LARGURA / 2, ALTURA / 2 + OFFSET_Y_BOTAO), TAMANHO_BOTAO, "Iniciar", vec3(0.0f, 1.0f, 0.0f)}, // Botão Iniciar (vermelho)
-    {vec2(LARGURA / 2, ALTURA / 2 - OFFSET_Y_BOTAO), TAMANHO_BOTAO, "Sair", vec3(1.0f, 0.0f, 0.0f)}};   // Botão Sair (roxo)
+// Liga ou desliga o blending
+void ativarBlend(bool ativo)
+{
+    if (estadoGL.blend == ativo)
+    {
+        estadoGL.chamadasEvitadas++;
+        return;
+    }
+    if (ativo)
+        glEnable(GL_BLEND);
+    else
+        glDisable(GL_BLEND);
+    estadoGL.blend = ativo;
+    estadoGL.chamadasEmitidas++;
+}
 
-// Código fonte dos shaders (programas que rodam na GPU)
-const GLchar *codigoFonteVertexShader = R"(
-    #version 400
-    layout (location = 0) in vec2 position;
-    layout (location = 1) in vec2 texc;
-    
-    uniform mat4 projection;
-    uniform mat4 model;
-    out vec2 tex_coord;
-    void main()
+// Define a equação de blending
+void definirFuncaoBlend(GLenum origem, GLenum destino)
+{
+    if (estadoGL.blendOrigem == origem && estadoGL.blendDestino == destino)
     {
-        tex_coord = vec2(texc.s,1.0-texc.t);
-        gl_Position = projection * model * vec4(position, 0.0, 1.0);
+        estadoGL.chamadasEvitadas++;
+        return;
     }
-)"; // Vertex Shader (processa vértices)
-const GLchar *fragmentShaderSource = R"(
-    #version 400
-    in vec2 tex_coord;
-    out vec4 color;
-    uniform sampler2D tex_buff;
-    uniform vec2 offset_tex;
-    uniform bool useSolidColor;
-    uniform vec3 solidColor;
-    
-    void main()
+    glBlendFunc(origem, destino);
+    estadoGL.blendOrigem = origem;
+    estadoGL.blendDestino = destino;
+    estadoGL.chamadasEmitidas++;
+}
+
+// Liga ou desliga o teste de profundidade
+void ativarDepthTest(bool ativo)
+{
+    if (estadoGL.depthTest == ativo)
+    {
+        estadoGL.chamadasEvitadas++;
+        return;
+    }
+    if (ativo)
+        glEnable(GL_DEPTH_TEST);
+    else
+        glDisable(GL_DEPTH_TEST);
+    estadoGL.depthTest = ativo;
+    estadoGL.chamadasEmitidas++;
+}
+
+// Define a função de comparação do teste de profundidade
+void definirFuncaoDepth(GLenum funcao)
+{
+    if (estadoGL.funcaoDepth == funcao)
+    {
+        estadoGL.chamadasEvitadas++;
+        return;
+    }
+    glDepthFunc(funcao);
+    estadoGL.funcaoDepth = funcao;
+    estadoGL.chamadasEmitidas++;
+}
+
+// Liga ou desliga a escrita no depth buffer
+void definirMascaraDepth(bool escrever)
+{
+    if (estadoGL.mascaraDepth == escrever)
+    {
+        estadoGL.chamadasEvitadas++;
+        return;
+    }
+    glDepthMask(escrever ? GL_TRUE : GL_FALSE);
+    estadoGL.mascaraDepth = escrever;
+    estadoGL.chamadasEmitidas++;
+}
+
+// Constantes do frame compartilhadas por todos os programas (mesmo layout std140 do bloco GLSL)
+struct ConstantesFrame
+{
+    mat4 projecao;     // Projeção ortográfica da área lógica do jogo
+    mat4 visao;        // Câmera (identidade enquanto o jogo não tem câmera)
+    vec4 tempo;        // x: segundos desde o início, y: delta do frame, z: distância percorrida na estrada
+    vec4 escalaRender; // xy: escala da resolução interna, zw: tamanho do alvo em pixels
+};
+const GLuint PONTO_LIGACAO_CONSTANTES_FRAME = 0; // Binding point fixo do bloco ConstantesFrame
+
+// Handle tipado para um uniform refletido de um ProgramaShader
+template <typename T>
+struct Uniforme
+{
+    int indice = -1; // Índice na tabela de uniforms do programa (-1 = inexistente/inativo)
+    bool valido() const { return indice >= 0; }
+};
+
+// Uniform ativo de um programa, lido uma única vez após o link
+struct UniformRefletido
+{
+    string nome;             // Nome no GLSL (sem o sufixo "[0]" de arrays)
+    GLint localizacao;       // Localização retornada pelo driver
+    GLenum tipo;             // Tipo GLSL (GL_FLOAT_VEC2, GL_SAMPLER_2D, ...)
+    GLint tamanho;           // Número de elementos (arrays)
+    unsigned char valor[64]; // Cópia na CPU do último valor enviado
+    bool definido;           // Se já recebeu algum valor
+};
+
+// Programa de shader com reflexão dos uniforms e cache dos últimos valores enviados
+class ProgramaShader
+{
+public:
+    GLuint id = 0; // ID do programa OpenGL
+
+    // Lê todos os uniforms ativos do programa (chamado uma vez após o link)
+    void refletir()
     {
-        if (useSolidColor) {
-            color = vec4(solidColor, 1.0);
-        } else {
-            color = texture(tex_buff, tex_coord + offset_tex);
+        uniforms.clear();
+        GLint numUniforms = 0;
+        glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &numUniforms);
+        for (GLint i = 0; i < numUniforms; i++)
+        {
+            GLchar nome[128];
+            GLsizei comprimento;
+            UniformRefletido uniform;
+            glGetActiveUniform(id, i, sizeof(nome), &comprimento, &uniform.tamanho, &uniform.tipo, nome);
+            uniform.nome = string(nome, comprimento);
+            if (uniform.nome.size() > 3 && uniform.nome.compare(uniform.nome.size() - 3, 3, "[0]") == 0)
+                uniform.nome.resize(uniform.nome.size() - 3);
+            uniform.localizacao = glGetUniformLocation(id, uniform.nome.c_str());
+            uniform.definido = false;
+            if (uniform.localizacao >= 0) // Uniforms de blocos não têm localização
+                uniforms.push_back(uniform);
         }
+
+        // Liga o bloco de constantes do frame (se o programa usar) ao binding point compartilhado
+        GLuint indiceBloco = glGetUniformBlockIndex(id, "ConstantesFrame");
+        if (indiceBloco != GL_INVALID_INDEX)
+            glUniformBlockBinding(id, indiceBloco, PONTO_LIGACAO_CONSTANTES_FRAME);
     }
-)"; // Fragment Shader (processa pixels)
 
-// configuraçoes fixas
-bool teclas[1024];                         // Array para estado das teclas (pressionadas ou não)
-float FPS = 12.0;                          // Frames por segundo para animação
-float ultimoTempo = 0.0;                   // Controle de tempo para animação
-GLuint VAOTexto, VBOTexto;                 // Buffers para renderização de texto
-GLuint texturaFonte;                       // Textura da fonte
-stbtt_bakedchar dadosCaracteres[96];       // Dados dos caracteres da fonte
-Sprite inimigos[MAX_INIMIGOS];             // Array de inimigos
-float temporizadorAparecerInimigos = 0.0f; // Contador para aparecer novos inimigos
-Sprite fundo, jogador;                     // Sprites do fundo e jogador
-GLFWwindow *janela;                        // Ponteiro para a janela GLFW
+    // Ativa o programa (não faz nada se ele já estiver em uso)
+    void usar() { usarPrograma(id); }
 
-// Implementação das funções
+    // Retorna o handle tipado de um uniform; inválido se não existir ou o tipo não bater
+    template <typename T>
+    Uniforme<T> uniforme(const char *nome) const
+    {
+        Uniforme<T> handle;
+        for (size_t i = 0; i < uniforms.size(); i++)
+        {
+            if (uniforms[i].nome != nome)
+                continue;
+            if (tipoCompativel(uniforms[i].tipo, (const T *)nullptr))
+                handle.indice = (int)i;
+            else
+                cerr << "Uniform '" << nome << "' com tipo diferente do esperado" << endl;
+            break;
+        }
+        return handle;
+    }
 
-// Inicializa os inimigos com texturas aleatórias
-void inicializarInimigos()
+    // Envia o valor ao uniform, pulando a chamada se ele não mudou desde o último envio
+    template <typename T>
+    void definir(Uniforme<T> handle, const T &valor)
+    {
+        if (!handle.valido())
+            return;
+        UniformRefletido &uniform = uniforms[handle.indice];
+        static_assert(sizeof(T) <= sizeof(uniform.valor), "valor de uniform grande demais");
+        if (uniform.definido && memcmp(uniform.valor, &valor, sizeof(T)) == 0)
+        {
+            uniformsEvitados++;
+            return;
+        }
+        memcpy(uniform.valor, &valor, sizeof(T));
+        uniform.definido = true;
+        if (estadoGL.programa != id) // glUniform* age sobre o programa em uso
+            usar();
+        enviarUniforme(uniform.localizacao, valor);
+        uniformsEnviados++;
+    }
+
+    static int uniformsEnviados; // glUniform* emitidos no frame
+    static int uniformsEvitados; // glUniform* evitados por valor repetido no frame
+
+private:
+    vector<UniformRefletido> uniforms; // Uniforms ativos refletidos
+
+    static bool tipoCompativel(GLenum tipo, const float *) { return tipo == GL_FLOAT; }
+    static bool tipoCompativel(GLenum tipo, const vec2 *) { return tipo == GL_FLOAT_VEC2; }
+    static bool tipoCompativel(GLenum tipo, const vec3 *) { return tipo == GL_FLOAT_VEC3; }
+    static bool tipoCompativel(GLenum tipo, const vec4 *) { return tipo == GL_FLOAT_VEC4; }
+    static bool tipoCompativel(GLenum tipo, const mat4 *) { return tipo == GL_FLOAT_MAT4; }
+    static bool tipoCompativel(GLenum tipo, const bool *) { return tipo == GL_BOOL; }
+    static bool tipoCompativel(GLenum tipo, const int *)
+    {
+        return tipo == GL_INT || tipo == GL_SAMPLER_2D || tipo == GL_SAMPLER_2D_ARRAY;
+    }
+
+    static void enviarUniforme(GLint loc, float v) { glUniform1f(loc, v); }
+    static void enviarUniforme(GLint loc, const vec2 &v) { glUniform2f(loc, v.x, v.y); }
+    static void enviarUniforme(GLint loc, const vec3 &v) { glUniform3f(loc, v.x, v.y, v.z); }
+    static void enviarUniforme(GLint loc, const vec4 &v) { glUniform4f(loc, v.x, v.y, v.z, v.w); }
+    static void enviarUniforme(GLint loc, const mat4 &v) { glUniformMatrix4fv(loc, 1, GL_FALSE, value_ptr(v)); }
+    static void enviarUniforme(GLint loc, bool v) { glUniform1i(loc, v ? GL_TRUE : GL_FALSE); }
+    static void enviarUniforme(GLint loc, int v) { glUniform1i(loc, v); }
+};
+int ProgramaShader::uniformsEnviados = 0;
+int ProgramaShader::uniformsEvitados = 0;
+
+// Recursos opcionais do shader de sprites; cada combinação é compilada como uma variante separada
+enum RecursoShader : uint32_t
 {
-    // Carrega as texturas dos carros inimigos
-    GLuint texturasCarros[NUM_TEXTURAS_CARROS];
-    texturasCarros[0] = carregarTextura("../assets/sprites/carro1.png");
-    texturasCarros[1] = carregarTextura("../assets/sprites/carro2.png");
-    texturasCarros[2] = carregarTextura("../assets/sprites/carro3.png");
-    texturasCarros[3] = carregarTextura("../assets/sprites/carro4.png");
+    RECURSO_COR_SOLIDA = 1u << 0,  // Pinta com uma cor sólida (sem textura)
+    RECURSO_TEXTURA = 1u << 1,     // Amostra a textura do sprite
+    RECURSO_TINGIMENTO = 1u << 2,  // Multiplica a cor final por uma cor de tingimento
+    RECURSO_UV_ANIMADO = 1u << 3,  // Escolhe o quadro da folha de sprites na GPU a partir do tempo do frame
+    RECURSO_INSTANCIADO = 1u << 4, // Lê posição, escala e UV dos atributos por instância
+    RECURSO_ROLAGEM = 1u << 5,     // Rola a textura pela distância percorrida (precisa de textura própria com GL_REPEAT)
+    RECURSO_RECORTE = 1u << 6,     // Descarta pixels transparentes (sprites opacos com recorte)
+    RECURSO_SOBREPOSICAO = 1u << 7, // Pinta cada fragmento com uma cor fixa, somada por blending (visualização)
+    RECURSO_PALETA = 1u << 8,      // A textura guarda índices (R8) e a cor vem da paleta (textura indexada)
+};
+const int NUM_VARIANTES_SHADER = 1 << 9; // Todas as combinações dos recursos acima
 
-    // Configura cada inimigo
-    for (int i = 0; i < MAX_INIMIGOS; i++)
+// Combinações usadas pelo jogo
+const uint32_t SPRITE_COR_SOLIDA = RECURSO_COR_SOLIDA;
+const uint32_t SPRITE_TEXTURIZADO = RECURSO_TEXTURA;
+const uint32_t SPRITE_ANIMADO = RECURSO_TEXTURA | RECURSO_UV_ANIMADO;
+const uint32_t SPRITE_ROLAGEM = RECURSO_TEXTURA | RECURSO_ROLAGEM;
+
+// Programa usado para desenhar sprites e os handles dos uniforms que o jogo usa
+struct ShaderSprite
+{
+    ProgramaShader programa;
+    Uniforme<vec4> posicaoAngulo; // Posição e rotação (só nas variantes não instanciadas)
+    Uniforme<vec4> escalaAncora;  // Escala e âncora (só nas variantes não instanciadas)
+    Uniforme<int> texBuff;     // Unidade de textura
+    Uniforme<vec2> offsetTex;  // Fator de parallax (ROLAGEM)
+    Uniforme<vec4> folhaAnimacao;  // Layout e velocidade da folha de sprites (UV_ANIMADO)
+    Uniforme<float> inicioAnimacao; // Início da animação (UV_ANIMADO)
+    Uniforme<vec4> uvRect;     // Retângulo UV do sprite (atlas)
+    Uniforme<vec3> solidColor; // Cor sólida
+    Uniforme<vec4> tint;       // Cor de tingimento
+    Uniforme<int> paleta;      // Unidade de textura da paleta (PALETA)
+    Uniforme<int> linhaPaleta; // Variante de cor (PALETA, só nas variantes não instanciadas)
+};
+
+// Funções e constantes do OpenGL 4.4 (ARB_buffer_storage), fora do glad 4.0 usado no projeto
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void(APIENTRYP PFNGLBUFFERSTORAGEPROC_JOGO)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+PFNGLBUFFERSTORAGEPROC_JOGO pglBufferStorage = nullptr; // Carregada em carregarExtensoesGL (nula se indisponível)
+
+// Texturas imutáveis do OpenGL 4.2 (ARB_texture_storage): todos os níveis alocados de uma vez
+typedef void(APIENTRYP PFNGLTEXSTORAGE2DPROC_JOGO)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+PFNGLTEXSTORAGE2DPROC_JOGO pglTexStorage2D = nullptr; // Nula se indisponível (cai para glTexImage2D por nível)
+
+// Binários de programa do OpenGL 4.1 (ARB_get_program_binary): o programa vinculado é guardado e recarregado
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+typedef void(APIENTRYP PFNGLGETPROGRAMBINARYPROC_JOGO)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void(APIENTRYP PFNGLPROGRAMBINARYPROC_JOGO)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void(APIENTRYP PFNGLPROGRAMPARAMETERIPROC_JOGO)(GLuint program, GLenum pname, GLint value);
+PFNGLGETPROGRAMBINARYPROC_JOGO pglGetProgramBinary = nullptr; // Nulas se indisponíveis ou se o driver não oferece
+PFNGLPROGRAMBINARYPROC_JOGO pglProgramBinary = nullptr;       // nenhum formato de binário (sempre compila)
+PFNGLPROGRAMPARAMETERIPROC_JOGO pglProgramParameteri = nullptr;
+
+// Mipmaps de cada textura: só valem a pena para texturas que aparecem reduzidas na tela
+enum PoliticaMipmap
+{
+    SEM_MIPMAPS,    // Só o nível 0 (sprites e fundos desenhados perto de 1:1)
+    MIPMAPS_GERADOS // Cadeia completa gerada na GPU, com filtro trilinear na redução
+};
+
+// Formato na GPU de uma imagem de 1 a 4 canais. Cinza e cinza+alpha usam swizzle para o shader ler
+// (L, L, L, 1) e (L, L, L, A), como se a imagem fosse RGBA.
+struct FormatoTextura
+{
+    GLenum formatoInterno; // Formato com tamanho (exigido pelo glTexStorage2D)
+    GLenum formato;        // Layout dos dados enviados
+    GLint swizzle[4];
+};
+const FormatoTextura FORMATOS_TEXTURA[4] = {
+    {GL_R8, GL_RED, {GL_RED, GL_RED, GL_RED, GL_ONE}},
+    {GL_RG8, GL_RG, {GL_RED, GL_RED, GL_RED, GL_GREEN}},
+    {GL_RGB8, GL_RGB, {GL_RED, GL_GREEN, GL_BLUE, GL_ONE}},
+    {GL_RGBA8, GL_RGBA, {GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA}}};
+
+// Texturas indexadas: um byte por pixel com o índice da cor numa paleta RGBA de CORES_PALETA entradas
+const int CORES_PALETA = 256;  // Largura da textura da paleta (índices de 8 bits)
+const int UNIDADE_PALETA = 1;  // Unidade de textura onde a paleta fica vinculada
+const int LINHAS_PALETA_ATLAS = 64; // Variantes de cor do atlas de sprites (linha 0 = cores originais)
+const int MATIZES_VARIANTES = 16;   // As variantes giram o matiz em passos de 360/16 graus...
+const float SATURACAO_VARIANTES[LINHAS_PALETA_ATLAS / MATIZES_VARIANTES] = {1.0f, 0.8f, 1.2f, 0.6f}; // ...com 4 saturações
+
+// Verifica se o contexto atual é pelo menos da versão indicada
+bool versaoGLMinima(int major, int minor)
+{
+    return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+// Carrega as funções opcionais que o glad 4.0 não inclui
+void carregarExtensoesGL()
+{
+    if (versaoGLMinima(4, 4) || glfwExtensionSupported("GL_ARB_buffer_storage"))
+        pglBufferStorage = (PFNGLBUFFERSTORAGEPROC_JOGO)glfwGetProcAddress("glBufferStorage");
+    if (versaoGLMinima(4, 2) || glfwExtensionSupported("GL_ARB_texture_storage"))
+        pglTexStorage2D = (PFNGLTEXSTORAGE2DPROC_JOGO)glfwGetProcAddress("glTexStorage2D");
+    if (versaoGLMinima(4, 1) || glfwExtensionSupported("GL_ARB_get_program_binary"))
     {
-        inimigos[i].VAO = configurarSprite(1, 1, inimigos[i].ds, inimigos[i].dt);
-        int tipoCarro = rand() % NUM_TEXTURAS_CARROS; // Escolhe textura aleatória
-        inimigos[i].idTextura = texturasCarros[tipoCarro];
-        inimigos[i].dimensoes = vec3(100.0f, 100.0f, 1.0f); // Tamanho padrão
-        inimigos[i].posicao = vec3(-100.0f, -100.0f, 0.0f); // Posição inicial fora da tela
-        inimigos[i].velocidade = VELOCIDADE_INIMIGO_BASE;   // Velocidade inicial
-        inimigos[i].numAnimacoes = 1;                       // Sem animações
-        inimigos[i].numQuadros = 1;                         // Apenas 1 quadro
-        inimigos[i].animacaoAtual = 0;
-        inimigos[i].quadroAtual = 0;
+        GLint formatos = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatos);
+        if (formatos > 0)
+        {
+            pglGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC_JOGO)glfwGetProcAddress("glGetProgramBinary");
+            pglProgramBinary = (PFNGLPROGRAMBINARYPROC_JOGO)glfwGetProcAddress("glProgramBinary");
+            pglProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC_JOGO)glfwGetProcAddress("glProgramParameteri");
+        }
     }
 }
 
-// Atualiza a posição e comportamento dos inimigos
-void atualizarInimigos(float deltaTempo)
+// Buffer de streaming em anel: uma região por frame em voo, cada uma protegida por uma fence.
+// Com ARB_buffer_storage fica mapeado de forma persistente e coerente; sem ele usa orphaning.
+class BufferStreaming
 {
-    if (estadoJogo != JOGANDO) // Só atualiza se estiver jogando
-        return;
+public:
+    static const int NUM_REGIOES = 3; // Triple buffering: CPU escreve uma região enquanto a GPU lê as outras
+
+    GLuint id = 0;            // Buffer OpenGL
+    bool persistente = false; // Se está usando o mapeamento persistente
+    int esperasFence = 0;     // Vezes que a CPU teve de esperar a GPU liberar uma região (no frame)
+
+    // Cria o buffer com NUM_REGIOES regiões de 'bytesPorRegiao' cada
+    void criar(GLenum alvoBuffer, GLsizeiptr bytesPorRegiao)
+    {
+        alvo = alvoBuffer;
+        tamanhoRegiao = (bytesPorRegiao + ALINHAMENTO - 1) / ALINHAMENTO * ALINHAMENTO;
+        glGenBuffers(1, &id);
+        glBindBuffer(alvo, id);
+        persistente = pglBufferStorage != nullptr;
+        if (persistente)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            pglBufferStorage(alvo, tamanhoRegiao * NUM_REGIOES, NULL, flags);
+            mapeado = (unsigned char *)glMapBufferRange(alvo, 0, tamanhoRegiao * NUM_REGIOES, flags);
+            persistente = mapeado != nullptr;
+        }
+        if (!persistente) // Sem buffer storage: um buffer comum, reespecificado a cada frame
+            glBufferData(alvo, tamanhoRegiao, NULL, GL_STREAM_DRAW);
+        glBindBuffer(alvo, 0);
+        for (int i = 0; i < NUM_REGIOES; i++)
+            fences[i] = 0;
+    }
 
-    // Carrega texturas dos carros (apenas na primeira vez)
-    static GLuint texturasCarros[NUM_TEXTURAS_CARROS];
-    static bool texturasCarregadas = false;
-    if (!texturasCarregadas)
+    // Reserva 'bytes' na região do frame e retorna onde escrever; 'offset' recebe a posição no buffer.
+    // Retorna nullptr se a região não tiver espaço. Deixa o buffer vinculado em 'alvo'.
+    void *reservar(GLsizeiptr bytes, GLintptr &offset)
     {
-        texturasCarros[0] = carregarTextura("../assets/sprites/carro1.png");
-        texturasCarros[1] = carregarTextura("../assets/sprites/carro2.png");
-        texturasCarros[2] = carregarTextura("../assets/sprites/carro3.png");
-        texturasCarros[3] = carregarTextura("../assets/sprites/carro4.png");
-        texturasCarregadas = true;
+        bytes = (bytes + ALINHAMENTO - 1) / ALINHAMENTO * ALINHAMENTO;
+        if (usadoNaRegiao + bytes > tamanhoRegiao)
+            return nullptr;
+
+        glBindBuffer(alvo, id);
+        if (usadoNaRegiao == 0) // Primeira escrita do frame nesta região
+            prepararRegiao();
+
+        if (persistente)
+        {
+            offset = regiaoAtual * tamanhoRegiao + usadoNaRegiao;
+            usadoNaRegiao += bytes;
+            return mapeado + offset;
+        }
+        // Orphaning: o buffer acabou de ser reespecificado, então mapear sem sincronizar é seguro
+        offset = usadoNaRegiao;
+        usadoNaRegiao += bytes;
+        return glMapBufferRange(alvo, offset, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
     }
 
-    // Atualiza temporizadores
-    temporizadorAparecerInimigos += deltaTempo;
-    static float tempoJogo = 0.0f;
-    tempoJogo += deltaTempo;
+    // Maior reserva que cabe numa região
+    GLsizeiptr capacidade() const { return tamanhoRegiao; }
 
-    // Aumenta dificuldade com o tempo
-    float velocidadeInimigoAtual = VELOCIDADE_INIMIGO_BASE + (tempoJogo * TAXA_AUMENTO_DIFICULDADE);
-    if (velocidadeInimigoAtual > VELOCIDADE_INIMIGO_MAXIMA)
+    // Termina a escrita da última reserva (só o caminho com orphaning precisa desmapear)
+    void concluirEscrita()
     {
-        velocidadeInimigoAtual = VELOCIDADE_INIMIGO_MAXIMA;
+        if (!persistente)
+            glUnmapBuffer(alvo);
     }
 
-    // Aparece novo inimigo se passou o intervalo
-    if (temporizadorAparecerInimigos >= INTERVALO_APARICAO_INIMIGOS)
+    // Fecha a região do frame com uma fence e passa para a próxima
+    void fimDoFrame()
     {
-        temporizadorAparecerInimigos = 0.0f;
-        for (int i = 0; i < MAX_INIMIGOS; i++)
+        if (usadoNaRegiao == 0)
+            return;
+        if (persistente)
         {
-            // Encontra um inimigo que não está na tela
-            if (inimigos[i].posicao.y < -50.0f)
-            {
-                // Posiciona em um lugar aleatório no topo da tela
-                inimigos[i].posicao.x = 100.0f + static_cast<float>(rand() % 600);
-                inimigos[i].posicao.y = ALTURA + 50.0f;
-                inimigos[i].velocidade = velocidadeInimigoAtual;
-                int tipoCarro = rand() % NUM_TEXTURAS_CARROS;
-                inimigos[i].idTextura = texturasCarros[tipoCarro];
-                break;
-            }
+            fences[regiaoAtual] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            regiaoAtual = (regiaoAtual + 1) % NUM_REGIOES;
         }
+        usadoNaRegiao = 0;
+    }
+
+private:
+    static const GLsizeiptr ALINHAMENTO = 64; // Alinhamento das reservas (linha de cache)
+
+    GLenum alvo = GL_ARRAY_BUFFER;
+    GLsizeiptr tamanhoRegiao = 0;
+    GLsizeiptr usadoNaRegiao = 0;
+    int regiaoAtual = 0;
+    unsigned char *mapeado = nullptr;
+    GLsync fences[NUM_REGIOES];
+
+    // Garante que a GPU terminou de ler a região antes de a CPU sobrescrevê-la
+    void prepararRegiao()
+    {
+        if (!persistente)
+        {
+            glBufferData(alvo, tamanhoRegiao, NULL, GL_STREAM_DRAW); // Orphaning
+            return;
+        }
+        GLsync fence = fences[regiaoAtual];
+        if (!fence)
+            return;
+        GLenum resultado = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (resultado == GL_TIMEOUT_EXPIRED)
+        {
+            esperasFence++;
+            while (resultado == GL_TIMEOUT_EXPIRED)
+                resultado = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        }
+        glDeleteSync(fence);
+        fences[regiaoAtual] = 0;
+    }
+};
+
+// Alvo fora da tela: o jogo desenha na resolução interna e o resultado é ampliado para a janela
+struct AlvoRender
+{
+    GLuint fbo = 0;              // FBO onde o jogo desenha
+    GLuint corMSAA = 0;          // Renderbuffer de cor multisample (só com MSAA)
+    GLuint profundidade = 0;     // Renderbuffer de profundidade
+    GLuint fboResolvido = 0;     // Destino do resolve do MSAA (0 quando não há MSAA)
+    GLuint textura = 0;          // Cor final amostrada na apresentação (no fbo ou no fboResolvido)
+    int largura = 0, altura = 0; // Resolução interna em pixels
+    int amostras = 0;            // Amostras por pixel (0 = sem MSAA)
+};
+
+// Nível de qualidade: resolução interna (fração da janela) e amostras de MSAA
+struct NivelQualidade
+{
+    float escala;     // Fração do tamanho da janela
+    int amostras;     // Amostras de MSAA (0 = sem MSAA)
+    const char *nome; // Nome mostrado no título
+};
+
+// Do mais caro para o mais barato; o governador anda por esta lista
+const NivelQualidade NIVEIS_QUALIDADE[] = {
+    {1.0f, 4, "100% MSAA 4x"},
+    {1.0f, 2, "100% MSAA 2x"},
+    {1.0f, 0, "100%"},
+    {0.75f, 0, "75%"},
+    {0.5f, 0, "50%"},
+};
+const int NUM_NIVEIS_QUALIDADE = sizeof(NIVEIS_QUALIDADE) / sizeof(NIVEIS_QUALIDADE[0]);
+
+// Ajusta o nível de qualidade comparando o tempo de GPU do frame com o orçamento
+struct GovernadorQualidade
+{
+    bool automatico = true;                // Desligado quando o nível é escolhido à mão (tecla Q)
+    int nivel = 0;                         // Índice em NIVEIS_QUALIDADE
+    double orcamentoMs = 1000.0 / 60.0;    // Tempo de frame alvo
+    double mediaMs = 0.0;                  // Média móvel do tempo de GPU medido
+    int framesMedidos = -1;                // Medições desde a última troca de nível (-1: descarta a próxima)
+    double custoMs[NUM_NIVEIS_QUALIDADE] = {}; // Último custo medido em cada nível (0 = ainda não medido)
+    GLuint consultasTempo[2];              // Timer queries alternadas (lidas um frame depois)
+    bool pendente[2] = {false, false};     // A consulta foi emitida e ainda não lida
+    int atual = 0;                         // Consulta usada neste frame
+};
+
+// Como o laço principal marca o ritmo dos frames
+enum ModoRitmo
+{
+    RITMO_VSYNC,          // Swap interval 1: o driver segura o frame até o vblank
+    RITMO_LIVRE,          // Sem limite: renderiza o mais rápido possível
+    RITMO_LIMITADO,       // Limite fixo: trabalha, espera (dorme e depois gira) e apresenta no prazo
+    RITMO_BAIXA_LATENCIA, // Just-in-time: espera primeiro e lê a entrada o mais perto possível do prazo
+    NUM_MODOS_RITMO
+};
+const char *NOMES_MODOS_RITMO[NUM_MODOS_RITMO] = {"vsync", "livre", "limitado", "baixa latencia"};
+
+// Agenda os frames conforme o modo e mede a regularidade (média e variância do intervalo entre apresentações)
+class AgendadorFrames
+{
+public:
+    ModoRitmo modo = RITMO_VSYNC;
+    double intervalo = 1.0 / 60.0; // Período alvo dos modos limitado e baixa latência (s)
+    double mediaMs = 0.0;          // Intervalo médio entre apresentações na última janela de medição
+    double desvioMs = 0.0;         // Desvio padrão do intervalo (raiz da variância)
+    double piorMs = 0.0;           // Maior intervalo da janela
+    double trabalhoMs = 0.0;       // Estimativa do trabalho de um frame (entrada até o fim do desenho)
+    bool semJanela = false;        // Headless: não há swap para sincronizar
+
+    // Troca de modo e reinicia o prazo e as estatísticas
+    void definirModo(ModoRitmo novoModo)
+    {
+        modo = novoModo;
+        if (!semJanela)
+            glfwSwapInterval(modo == RITMO_VSYNC ? 1 : 0);
+        prazo = 0.0;
+        ultimaApresentacao = 0.0;
+        mediaMs = desvioMs = piorMs = 0.0;
+        zerarJanela();
+    }
+
+    // Chamado antes de ler a entrada. No modo baixa latência espera até o prazo menos o trabalho previsto,
+    // para que entrada e simulação aconteçam o mais tarde possível
+    void antesDoFrame()
+    {
+        if (modo == RITMO_BAIXA_LATENCIA)
+        {
+            avancarPrazo();
+            esperarAte(prazo - (trabalhoMs / 1000.0) * FATOR_SEGURANCA - MARGEM_TRABALHO);
+        }
+        inicioTrabalho = glfwGetTime();
+    }
+
+    // Chamado depois de desenhar. No modo limitado segura a apresentação até o prazo
+    void antesDaApresentacao()
+    {
+        fimTrabalho = glfwGetTime(); // Antes de qualquer espera: a estimativa não pode incluir a folga
+        if (modo == RITMO_LIMITADO)
+        {
+            avancarPrazo();
+            esperarAte(prazo);
+        }
+        else if (modo == RITMO_BAIXA_LATENCIA)
+        {
+            esperarAte(prazo); // Se o trabalho foi mais rápido que o previsto, não adianta o frame
+        }
+    }
+
+    // Chamado logo depois do swap: atualiza a estimativa de trabalho e as estatísticas. O trabalho vai da
+    // leitura da entrada ao fim do desenho; espera e swap ficam de fora, senão a estimativa realimenta a
+    // própria espera do modo baixa latência e cresce a cada frame
+    void depoisDaApresentacao()
+    {
+        double agora = glfwGetTime();
+        double trabalho = (fimTrabalho - inicioTrabalho) * 1000.0;
+        // Sobe rápido e desce devagar: errar para menos custa um frame atrasado
+        trabalhoMs = trabalho > trabalhoMs ? trabalho : trabalhoMs * 0.95 + trabalho * 0.05;
+
+        if (ultimaApresentacao > 0.0)
+        {
+            double intervaloMs = (agora - ultimaApresentacao) * 1000.0;
+            amostras++;
+            soma += intervaloMs;
+            somaQuadrados += intervaloMs * intervaloMs;
+            maior = glm::max(maior, intervaloMs);
+            if (amostras >= FRAMES_POR_JANELA)
+            {
+                mediaMs = soma / amostras;
+                desvioMs = sqrt(glm::max(0.0, somaQuadrados / amostras - mediaMs * mediaMs));
+                piorMs = maior;
+                zerarJanela();
+            }
+        }
+        ultimaApresentacao = agora;
+    }
+
+private:
+    static constexpr double MARGEM_SPIN = 0.002;      // Últimos 2 ms da espera são feitos girando (o sleep é impreciso)
+    static constexpr double MARGEM_TRABALHO = 0.001;  // Folga extra antes do prazo no modo baixa latência
+    static constexpr double FATOR_SEGURANCA = 1.25;   // Multiplica o trabalho previsto no modo baixa latência
+    static const int FRAMES_POR_JANELA = 120;         // Frames por janela de estatística
+
+    double prazo = 0.0;              // Próximo instante de apresentação (s, relógio do GLFW)
+    double inicioTrabalho = 0.0;     // Quando o frame atual começou a ler a entrada
+    double fimTrabalho = 0.0;        // Quando o frame atual terminou de desenhar (antes da espera)
+    double ultimaApresentacao = 0.0; // Instante do último swap
+    int amostras = 0;
+    double soma = 0.0, somaQuadrados = 0.0, maior = 0.0;
+
+    // Avança o prazo um período; se atrasou mais que um período, realinha em vez de tentar recuperar
+    void avancarPrazo()
+    {
+        double agora = glfwGetTime();
+        prazo += intervalo;
+        if (prazo < agora)
+            prazo = agora + (modo == RITMO_BAIXA_LATENCIA ? intervalo : 0.0);
+    }
+
+    // Espera híbrida: dorme enquanto falta bastante e gira nos últimos milissegundos
+    static void esperarAte(double instante)
+    {
+        double restante = instante - glfwGetTime();
+        if (restante > MARGEM_SPIN)
+            std::this_thread::sleep_for(std::chrono::duration<double>(restante - MARGEM_SPIN));
+        while (glfwGetTime() < instante)
+            std::this_thread::yield();
+    }
+
+    void zerarJanela()
+    {
+        amostras = 0;
+        soma = somaQuadrados = maior = 0.0;
+    }
+};
+
+// Textura guardada na memória para o rasterizador em software
+struct TexturaSoftware
+{
+    vector<uint32_t> texels;     // RGBA8 (R no byte mais baixo); linha 0 = primeira linha da imagem, como no glTexImage2D
+    int largura = 0, altura = 0;
+    bool repetir = false;        // GL_REPEAT (fundo que rola); senão GL_CLAMP_TO_EDGE
+    vector<unsigned char> indices; // Textura indexada: índice da cor de cada texel (vazio se não for)
+    vector<uint32_t> paleta;       // CORES_PALETA cores por linha, como os texels
+    vector<int> variantes;         // Id da textura já expandida com cada linha da paleta (0 = ainda não)
+};
+
+// Como um quad é pintado pelo rasterizador em software (espelha os passes do OpenGL)
+enum ModoQuadSoftware : uint8_t
+{
+    QUAD_OPACO,       // Sem blending, recorte em alpha 0.5 e escrita de profundidade (passe opaco)
+    QUAD_TRANSLUCIDO, // Blending alpha, testa a profundidade sem escrever (passe translúcido)
+    QUAD_COR_SOLIDA,  // Cor sólida com escrita de profundidade (botões do menu)
+    QUAD_TEXTO_SDF    // Cobertura calculada da distância no canal R (filtro bilinear), sem profundidade
+};
+
+// Quad já em pixels do alvo: p(s, t) = origem + s * eixoS + t * eixoT, com s e t em [0, 1).
+// A coordenada de textura, em texels, é afim em s e t: texBase + (s, t) * texEscala.
+struct QuadSoftware
+{
+    vec2 origem, eixoS, eixoT;
+    vec2 texBase, texEscala;
+    float profundidade;      // Profundidade da janela (0 = perto, 1 = longe), constante no quad
+    bool testarProfundidade; // GL_LESS; senão GL_ALWAYS
+    uint32_t cor;            // Tingimento (ou a cor sólida) RGBA8
+    int textura;             // Índice em RasterizadorSoftware::texturas (-1 = sem textura)
+    ModoQuadSoftware modo;
+    float suavizacao;        // Meia largura da transição do contorno (QUAD_TEXTO_SDF)
+};
+
+// Multiplica cada canal de 'a' pelo de 'b' (b + 1 para 255 não alterar o valor); o caminho SIMD faz a mesma conta
+inline uint32_t multiplicarCor(uint32_t a, uint32_t b)
+{
+    uint32_t resultado = 0;
+    for (int deslocamento = 0; deslocamento < 32; deslocamento += 8)
+        resultado |= ((((a >> deslocamento) & 0xFF) * (((b >> deslocamento) & 0xFF) + 1)) >> 8) << deslocamento;
+    return resultado;
+}
+
+// Blending GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA em todos os canais, com divisão por 255 arredondada
+inline uint32_t misturarCor(uint32_t fonte, uint32_t destino)
+{
+    uint32_t alpha = fonte >> 24, resultado = 0;
+    for (int deslocamento = 0; deslocamento < 32; deslocamento += 8)
+    {
+        uint32_t soma = ((fonte >> deslocamento) & 0xFF) * alpha + ((destino >> deslocamento) & 0xFF) * (255 - alpha) + 128;
+        resultado |= ((soma + (soma >> 8)) >> 8) << deslocamento;
+    }
+    return resultado;
+}
+
+// Texel de uma coordenada (em texels) com o endereçamento da textura
+inline int enderecarTexel(float coordenada, int tamanho, bool repetir)
+{
+    float piso = floorf(coordenada);
+    if (repetir)
+        piso -= tamanho * floorf(piso / tamanho);
+    return glm::clamp((int)piso, 0, tamanho - 1);
+}
+
+#if RASTERIZADOR_SSE2
+// floor() de 4 floats só com SSE2 (trunca e corrige os negativos)
+inline __m128 pisoSse(__m128 valor)
+{
+    __m128 truncado = _mm_cvtepi32_ps(_mm_cvttps_epi32(valor));
+    return _mm_sub_ps(truncado, _mm_and_ps(_mm_cmplt_ps(valor, truncado), _mm_set1_ps(1.0f)));
+}
+
+// Mesmo endereçamento de enderecarTexel para 4 coordenadas (resultado em float, exato até 2^24)
+inline __m128 enderecarTexelsSse(__m128 coordenada, float tamanho, bool repetir)
+{
+    __m128 piso = pisoSse(coordenada);
+    if (repetir)
+        piso = _mm_sub_ps(piso, _mm_mul_ps(_mm_set1_ps(tamanho), pisoSse(_mm_div_ps(piso, _mm_set1_ps(tamanho)))));
+    return _mm_min_ps(_mm_max_ps(piso, _mm_setzero_ps()), _mm_set1_ps(tamanho - 1.0f));
+}
+
+// Blending alpha de 4 pixels (mesma conta de misturarCor, em inteiros de 16 bits)
+inline __m128i misturarCoresSse(__m128i fonte, __m128i destino)
+{
+    const __m128i zero = _mm_setzero_si128(), maximo = _mm_set1_epi16(255), meio = _mm_set1_epi16(128);
+    __m128i resultado[2];
+    for (int metade = 0; metade < 2; metade++)
+    {
+        __m128i f = metade ? _mm_unpackhi_epi8(fonte, zero) : _mm_unpacklo_epi8(fonte, zero);
+        __m128i d = metade ? _mm_unpackhi_epi8(destino, zero) : _mm_unpacklo_epi8(destino, zero);
+        __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(f, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m128i soma = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(f, alpha), _mm_mullo_epi16(d, _mm_sub_epi16(maximo, alpha))), meio);
+        resultado[metade] = _mm_srli_epi16(_mm_add_epi16(soma, _mm_srli_epi16(soma, 8)), 8);
+    }
+    return _mm_packus_epi16(resultado[0], resultado[1]);
+}
+#endif
+
+// Rasterizador de quads na CPU, para quando não há OpenGL utilizável (ou com --software).
+// Os quads do frame são guardados em ordem e distribuídos pelos blocos (tiles) da tela que cobrem;
+// no fim do frame as threads pegam blocos inteiros e pintam seus quads na ordem de submissão, então
+// nenhum pixel é disputado e o resultado não depende do número de threads. Os trechos de linha
+// usam AVX2 (8 pixels) ou SSE2 (4 pixels) quando o compilador permite.
+class RasterizadorSoftware
+{
+public:
+    static const int TAMANHO_BLOCO = 64; // Lado do bloco em pixels (cor e profundidade cabem no cache L2)
+
+    int largura = 0, altura = 0;       // Resolução do alvo
+    vector<uint32_t> cor;              // RGBA8, linha 0 embaixo (mesma ordem do glReadPixels/glDrawPixels)
+    vector<float> profundidade;        // Profundidade por pixel
+    vector<TexturaSoftware> texturas;  // O id de textura do jogo é o índice + 1 (0 = nenhuma)
+    int numThreads = 1;                // Threads que pintam (incluindo a principal)
+    double ultimoTempoMs = 0.0;        // Duração do último renderizar()
+
+    // Cria as threads auxiliares (a thread principal também pinta)
+    void iniciar(int threads)
+    {
+        numThreads = glm::max(1, threads);
+        for (int i = 1; i < numThreads; i++)
+            auxiliares.emplace_back(&RasterizadorSoftware::executarAuxiliar, this);
+    }
+
+    // Encerra as threads auxiliares (antes de sair do programa)
+    void encerrar()
+    {
+        {
+            lock_guard<mutex> bloqueio(trava);
+            sair = true;
+        }
+        sinalTrabalho.notify_all();
+        for (thread &auxiliar : auxiliares)
+            auxiliar.join();
+        auxiliares.clear();
+    }
+
+    void redimensionar(int novaLargura, int novaAltura)
+    {
+        largura = novaLargura;
+        altura = novaAltura;
+        cor.assign((size_t)largura * altura, 0);
+        profundidade.assign((size_t)largura * altura, 1.0f);
+        blocosX = (largura + TAMANHO_BLOCO - 1) / TAMANHO_BLOCO;
+        blocosY = (altura + TAMANHO_BLOCO - 1) / TAMANHO_BLOCO;
+        blocos.assign(blocosX * blocosY, vector<uint32_t>());
+    }
+
+    // Guarda uma cópia da imagem e retorna o id da textura. Cinza e cinza+alpha viram (L, L, L, 1) e
+    // (L, L, L, A), como o swizzle de FORMATOS_TEXTURA faz na GPU.
+    GLuint criarTextura(const unsigned char *dados, int larguraTextura, int alturaTextura, int canais, bool repetir)
+    {
+        TexturaSoftware textura;
+        textura.largura = larguraTextura;
+        textura.altura = alturaTextura;
+        textura.repetir = repetir;
+        textura.texels.resize((size_t)larguraTextura * alturaTextura);
+        for (size_t i = 0; i < textura.texels.size(); i++)
+        {
+            const unsigned char *p = dados + i * canais;
+            uint32_t r = p[0], g = canais > 2 ? p[1] : r, b = canais > 2 ? p[2] : r;
+            uint32_t a = canais == 4 ? p[3] : canais == 2 ? p[1] : 255;
+            textura.texels[i] = r | (g << 8) | (b << 16) | (a << 24);
+        }
+        texturas.push_back(textura);
+        return (GLuint)texturas.size();
+    }
+
+    // Textura indexada: guarda os índices e a paleta e expande a linha 0. As outras linhas viram texturas
+    // RGBA na primeira vez que um quad as usa (texturaDaLinha), então o caminho SIMD só lê texels.
+    GLuint criarTexturaIndexada(const vector<unsigned char> &indices, const vector<unsigned char> &paleta, int larguraTextura,
+                                int alturaTextura, bool repetir)
+    {
+        TexturaSoftware textura;
+        textura.largura = larguraTextura;
+        textura.altura = alturaTextura;
+        textura.repetir = repetir;
+        textura.indices = indices;
+        textura.paleta.resize(paleta.size() / 4);
+        memcpy(textura.paleta.data(), paleta.data(), paleta.size());
+        textura.variantes.assign(textura.paleta.size() / CORES_PALETA, 0);
+        textura.variantes[0] = (int)texturas.size() + 1;
+        textura.texels.resize(indices.size());
+        expandirIndices(textura, 0, textura.texels);
+        texturas.push_back(textura);
+        return (GLuint)texturas.size();
+    }
+
+    // Textura com as cores de uma linha da paleta (a própria textura se ela não for indexada).
+    // Só chamada na thread principal, fora de renderizar()
+    GLuint texturaDaLinha(GLuint textura, int linha)
+    {
+        if (textura == 0 || linha <= 0 || linha >= (int)texturas[textura - 1].variantes.size())
+            return textura;
+        if (texturas[textura - 1].variantes[linha] == 0)
+        {
+            TexturaSoftware variante;
+            variante.largura = texturas[textura - 1].largura;
+            variante.altura = texturas[textura - 1].altura;
+            variante.repetir = texturas[textura - 1].repetir;
+            variante.texels.resize(texturas[textura - 1].indices.size());
+            expandirIndices(texturas[textura - 1], linha, variante.texels);
+            texturas.push_back(variante);
+            texturas[textura - 1].variantes[linha] = (int)texturas.size();
+        }
+        return (GLuint)texturas[textura - 1].variantes[linha];
+    }
+
+    // Equivale ao glClear de cor e profundidade: descarta o que foi desenhado antes no frame
+    void limpar(vec4 corLimpeza)
+    {
+        u8vec4 bytes = u8vec4(glm::clamp(corLimpeza, 0.0f, 1.0f) * 255.0f + 0.5f);
+        limpeza = bytes.r | (bytes.g << 8) | (bytes.b << 16) | ((uint32_t)bytes.a << 24);
+        quads.clear();
+    }
+
+    void adicionar(const QuadSoftware &quad)
+    {
+        quads.push_back(quad);
+    }
+
+    // Distribui os quads pelos blocos e pinta o frame com todas as threads
+    void renderizar()
+    {
+        double inicio = glfwGetTime();
+        for (vector<uint32_t> &bloco : blocos)
+            bloco.clear();
+        for (size_t i = 0; i < quads.size(); i++)
+        {
+            const QuadSoftware &q = quads[i];
+            vec2 minimo = glm::min(glm::min(q.origem, q.origem + q.eixoS), glm::min(q.origem + q.eixoT, q.origem + q.eixoS + q.eixoT));
+            vec2 maximo = glm::max(glm::max(q.origem, q.origem + q.eixoS), glm::max(q.origem + q.eixoT, q.origem + q.eixoS + q.eixoT));
+            int bx0 = glm::max(0, (int)floorf(minimo.x) / TAMANHO_BLOCO), by0 = glm::max(0, (int)floorf(minimo.y) / TAMANHO_BLOCO);
+            int bx1 = glm::min(blocosX - 1, (int)ceilf(maximo.x) / TAMANHO_BLOCO);
+            int by1 = glm::min(blocosY - 1, (int)ceilf(maximo.y) / TAMANHO_BLOCO);
+            for (int by = by0; by <= by1; by++)
+                for (int bx = bx0; bx <= bx1; bx++)
+                    blocos[by * blocosX + bx].push_back((uint32_t)i);
+        }
+
+        proximoBloco = 0;
+        {
+            lock_guard<mutex> bloqueio(trava);
+            auxiliaresTrabalhando = (int)auxiliares.size();
+            geracao++;
+        }
+        sinalTrabalho.notify_all();
+        pintarBlocos();
+        {
+            unique_lock<mutex> bloqueio(trava);
+            sinalConcluido.wait(bloqueio, [this] { return auxiliaresTrabalhando == 0; });
+        }
+        quads.clear();
+        ultimoTempoMs = (glfwGetTime() - inicio) * 1000.0;
+    }
+
+private:
+    vector<QuadSoftware> quads;      // Quads do frame, na ordem de submissão
+    vector<vector<uint32_t>> blocos; // Índices dos quads que tocam cada bloco, em ordem
+    int blocosX = 0, blocosY = 0;
+    uint32_t limpeza = 0xFF000000;   // Cor de limpeza RGBA8
+    atomic<int> proximoBloco{0};     // Próximo bloco livre para uma thread pegar
+
+    vector<thread> auxiliares;
+    mutex trava;
+    condition_variable sinalTrabalho, sinalConcluido;
+    int geracao = 0;                 // Frames entregues às threads auxiliares
+    int auxiliaresTrabalhando = 0;
+    bool sair = false;
+
+    // Troca cada índice pela cor da linha da paleta
+    static void expandirIndices(const TexturaSoftware &textura, int linha, vector<uint32_t> &texels)
+    {
+        const uint32_t *cores = &textura.paleta[(size_t)linha * CORES_PALETA];
+        for (size_t i = 0; i < textura.indices.size(); i++)
+            texels[i] = cores[textura.indices[i]];
+    }
+
+    void executarAuxiliar()
+    {
+        int vista = 0;
+        while (true)
+        {
+            {
+                unique_lock<mutex> bloqueio(trava);
+                sinalTrabalho.wait(bloqueio, [&] { return sair || geracao != vista; });
+                if (sair)
+                    return;
+                vista = geracao;
+            }
+            pintarBlocos();
+            {
+                lock_guard<mutex> bloqueio(trava);
+                auxiliaresTrabalhando--;
+            }
+            sinalConcluido.notify_one();
+        }
+    }
+
+    void pintarBlocos()
+    {
+        for (int indice = proximoBloco++; indice < blocosX * blocosY; indice = proximoBloco++)
+        {
+            int x0 = (indice % blocosX) * TAMANHO_BLOCO, y0 = (indice / blocosX) * TAMANHO_BLOCO;
+            int x1 = glm::min(x0 + TAMANHO_BLOCO, largura), y1 = glm::min(y0 + TAMANHO_BLOCO, altura);
+            for (int y = y0; y < y1; y++)
+            {
+                std::fill(&cor[(size_t)y * largura + x0], &cor[(size_t)y * largura + x1], limpeza);
+                std::fill(&profundidade[(size_t)y * largura + x0], &profundidade[(size_t)y * largura + x1], 1.0f);
+            }
+            for (uint32_t q : blocos[indice])
+                pintarQuad(quads[q], x0, y0, x1, y1);
+        }
+    }
+
+    // Restringe [x0, x1) aos pixels cujo centro tem 0 <= base + passo * x < 1
+    static void limitarTrecho(float base, float passo, int &x0, int &x1)
+    {
+        if (passo == 0.0f)
+        {
+            if (base < 0.0f || base >= 1.0f)
+                x1 = x0;
+            return;
+        }
+        float a = glm::clamp(-base / passo, -1.0e6f, 1.0e6f), b = glm::clamp((1.0f - base) / passo, -1.0e6f, 1.0e6f);
+        if (passo > 0.0f)
+        {
+            x0 = glm::max(x0, (int)ceilf(a));
+            x1 = glm::min(x1, (int)ceilf(b));
+        }
+        else
+        {
+            x0 = glm::max(x0, (int)floorf(b) + 1);
+            x1 = glm::min(x1, (int)floorf(a) + 1);
+        }
+    }
+
+    // Pinta a parte do quad dentro do retângulo [x0, x1) x [y0, y1), linha a linha
+    void pintarQuad(const QuadSoftware &q, int x0, int y0, int x1, int y1)
+    {
+        // Inverte p = origem + s * eixoS + t * eixoT: s e t variam linearmente em x e y
+        float det = q.eixoS.x * q.eixoT.y - q.eixoS.y * q.eixoT.x;
+        if (fabsf(det) < 1.0e-8f)
+            return;
+        float sx = q.eixoT.y / det, sy = -q.eixoT.x / det;
+        float tx = -q.eixoS.y / det, ty = q.eixoS.x / det;
+        for (int y = y0; y < y1; y++)
+        {
+            // s e t no centro do pixel x = 0 desta linha
+            float dy = y + 0.5f - q.origem.y, dx = 0.5f - q.origem.x;
+            float s0 = sx * dx + sy * dy, t0 = tx * dx + ty * dy;
+            int inicio = x0, fim = x1;
+            limitarTrecho(s0, sx, inicio, fim);
+            limitarTrecho(t0, tx, inicio, fim);
+            if (inicio >= fim)
+                continue;
+            float u0 = q.texBase.x + q.texEscala.x * s0, du = q.texEscala.x * sx;
+            float v0 = q.texBase.y + q.texEscala.y * t0, dv = q.texEscala.y * tx;
+            pintarTrecho(q, y, inicio, fim, u0, du, v0, dv);
+        }
+    }
+
+    // Pinta os pixels [x0, x1) da linha y; a coordenada de textura do pixel x é (u0 + du * x, v0 + dv * x)
+    void pintarTrecho(const QuadSoftware &q, int y, int x0, int x1, float u0, float du, float v0, float dv)
+    {
+        uint32_t *linhaCor = &cor[(size_t)y * largura];
+        float *linhaProfundidade = &profundidade[(size_t)y * largura];
+
+        if (q.modo == QUAD_COR_SOLIDA)
+        {
+            for (int x = x0; x < x1; x++)
+                if (!q.testarProfundidade || q.profundidade < linhaProfundidade[x])
+                {
+                    linhaCor[x] = q.cor;
+                    linhaProfundidade[x] = q.profundidade;
+                }
+            return;
+        }
+        const TexturaSoftware &textura = texturas[q.textura];
+        if (q.modo == QUAD_TEXTO_SDF)
+        {
+            for (int x = x0; x < x1; x++)
+            {
+                float distancia = amostrarBilinearR(textura, u0 + du * x, v0 + dv * x);
+                float cobertura = glm::smoothstep(0.5f - q.suavizacao, 0.5f + q.suavizacao, distancia);
+                uint32_t fonte = (q.cor & 0xFFFFFF) | ((uint32_t)((q.cor >> 24) * cobertura + 0.5f) << 24);
+                linhaCor[x] = misturarCor(fonte, linhaCor[x]);
+            }
+            return;
+        }
+
+        int x = x0;
+        const uint32_t *texels = textura.texels.data();
+#if RASTERIZADOR_SSE2
+        __m128i tingimento = _mm_add_epi16(_mm_unpacklo_epi8(_mm_set1_epi32((int)q.cor), _mm_setzero_si128()), _mm_set1_epi16(1));
+#endif
+#if RASTERIZADOR_AVX2
+        const __m256 deslocamentos8 = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+        for (; x + 8 <= x1; x += 8)
+        {
+            __m256 posicoes = _mm256_add_ps(_mm256_set1_ps((float)x), deslocamentos8);
+            __m256 u = _mm256_add_ps(_mm256_set1_ps(u0), _mm256_mul_ps(_mm256_set1_ps(du), posicoes));
+            __m256 v = _mm256_add_ps(_mm256_set1_ps(v0), _mm256_mul_ps(_mm256_set1_ps(dv), posicoes));
+            __m256 iu = enderecarTexelsAvx(u, (float)textura.largura, textura.repetir);
+            __m256 iv = enderecarTexelsAvx(v, (float)textura.altura, textura.repetir);
+            __m256i indices = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(iv, _mm256_set1_ps((float)textura.largura)), iu));
+            __m256i amostras = _mm256_i32gather_epi32((const int *)texels, indices, 4);
+            combinarPixelsSse(q, _mm256_castsi256_si128(amostras), tingimento, linhaCor + x, linhaProfundidade + x);
+            combinarPixelsSse(q, _mm256_extracti128_si256(amostras, 1), tingimento, linhaCor + x + 4, linhaProfundidade + x + 4);
+        }
+#endif
+#if RASTERIZADOR_SSE2
+        const __m128 deslocamentos4 = _mm_setr_ps(0, 1, 2, 3);
+        for (; x + 4 <= x1; x += 4)
+        {
+            __m128 posicoes = _mm_add_ps(_mm_set1_ps((float)x), deslocamentos4);
+            __m128 u = _mm_add_ps(_mm_set1_ps(u0), _mm_mul_ps(_mm_set1_ps(du), posicoes));
+            __m128 v = _mm_add_ps(_mm_set1_ps(v0), _mm_mul_ps(_mm_set1_ps(dv), posicoes));
+            __m128 iu = enderecarTexelsSse(u, (float)textura.largura, textura.repetir);
+            __m128 iv = enderecarTexelsSse(v, (float)textura.altura, textura.repetir);
+            alignas(16) int indices[4];
+            _mm_store_si128((__m128i *)indices, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(iv, _mm_set1_ps((float)textura.largura)), iu)));
+            __m128i amostras = _mm_setr_epi32((int)texels[indices[0]], (int)texels[indices[1]], (int)texels[indices[2]], (int)texels[indices[3]]);
+            combinarPixelsSse(q, amostras, tingimento, linhaCor + x, linhaProfundidade + x);
+        }
+#endif
+        for (; x < x1; x++)
+        {
+            int iu = enderecarTexel(u0 + du * x, textura.largura, textura.repetir);
+            int iv = enderecarTexel(v0 + dv * x, textura.altura, textura.repetir);
+            uint32_t fonte = multiplicarCor(texels[iv * textura.largura + iu], q.cor);
+            if (q.testarProfundidade && !(q.profundidade < linhaProfundidade[x]))
+                continue;
+            if (q.modo == QUAD_OPACO)
+            {
+                if ((fonte >> 24) < 128) // Recorte
+                    continue;
+                linhaCor[x] = fonte;
+                linhaProfundidade[x] = q.profundidade;
+            }
+            else
+            {
+                linhaCor[x] = misturarCor(fonte, linhaCor[x]);
+            }
+        }
+    }
+
+#if RASTERIZADOR_SSE2
+    // Tinge, testa e grava 4 pixels já amostrados (mesmas regras do laço escalar de pintarTrecho)
+    static void combinarPixelsSse(const QuadSoftware &q, __m128i texels, __m128i tingimento, uint32_t *destinoCor, float *destinoProfundidade)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i baixo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(texels, zero), tingimento), 8);
+        __m128i alto = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(texels, zero), tingimento), 8);
+        __m128i fonte = _mm_packus_epi16(baixo, alto);
+
+        __m128 profundidadeAnterior = _mm_loadu_ps(destinoProfundidade);
+        __m128i passa = q.testarProfundidade ? _mm_castps_si128(_mm_cmplt_ps(_mm_set1_ps(q.profundidade), profundidadeAnterior))
+                                             : _mm_set1_epi32(-1);
+        __m128i anterior = _mm_loadu_si128((const __m128i *)destinoCor);
+        __m128i novo;
+        if (q.modo == QUAD_OPACO)
+        {
+            passa = _mm_and_si128(passa, _mm_srai_epi32(fonte, 31)); // Recorte: bit mais alto do alpha
+            novo = fonte;
+            __m128 mascara = _mm_castsi128_ps(passa);
+            _mm_storeu_ps(destinoProfundidade, _mm_or_ps(_mm_and_ps(mascara, _mm_set1_ps(q.profundidade)),
+                                                         _mm_andnot_ps(mascara, profundidadeAnterior)));
+        }
+        else
+        {
+            novo = misturarCoresSse(fonte, anterior);
+        }
+        _mm_storeu_si128((__m128i *)destinoCor, _mm_or_si128(_mm_and_si128(passa, novo), _mm_andnot_si128(passa, anterior)));
+    }
+#endif
+
+#if RASTERIZADOR_AVX2
+    static __m256 enderecarTexelsAvx(__m256 coordenada, float tamanho, bool repetir)
+    {
+        __m256 piso = _mm256_floor_ps(coordenada);
+        if (repetir)
+            piso = _mm256_sub_ps(piso, _mm256_mul_ps(_mm256_set1_ps(tamanho), _mm256_floor_ps(_mm256_div_ps(piso, _mm256_set1_ps(tamanho)))));
+        return _mm256_min_ps(_mm256_max_ps(piso, _mm256_setzero_ps()), _mm256_set1_ps(tamanho - 1.0f));
+    }
+#endif
+
+    // Filtro bilinear do canal R (como GL_LINEAR com GL_CLAMP_TO_EDGE), resultado em [0, 1]
+    static float amostrarBilinearR(const TexturaSoftware &textura, float u, float v)
+    {
+        u -= 0.5f;
+        v -= 0.5f;
+        float pu = floorf(u), pv = floorf(v);
+        float fu = u - pu, fv = v - pv;
+        int u0 = glm::clamp((int)pu, 0, textura.largura - 1), u1 = glm::clamp((int)pu + 1, 0, textura.largura - 1);
+        int v0 = glm::clamp((int)pv, 0, textura.altura - 1), v1 = glm::clamp((int)pv + 1, 0, textura.altura - 1);
+        const uint32_t *linha0 = &textura.texels[(size_t)v0 * textura.largura], *linha1 = &textura.texels[(size_t)v1 * textura.largura];
+        float acima = (linha0[u0] & 0xFF) * (1.0f - fu) + (linha0[u1] & 0xFF) * fu;
+        float abaixo = (linha1[u0] & 0xFF) * (1.0f - fu) + (linha1[u1] & 0xFF) * fu;
+        return (acima * (1.0f - fv) + abaixo * fv) / 255.0f;
+    }
+};
+
+// Anel de pixel buffer objects para ler framebuffers sem travar o laço: o glReadPixels grava no PBO (a
+// cópia fica na fila da GPU e a CPU segue) e cada PBO só é mapeado depois que a fence dele sinaliza, alguns
+// frames mais tarde. As imagens chegam a 'entregar' na mesma ordem em que foram pedidas.
+class AnelLeituraPixels
+{
+public:
+    static const int NUM_PBOS = 3; // Leituras em voo antes de precisar esperar a GPU
+
+    // Recebe a imagem (RGBA8, linha 0 embaixo como no OpenGL) e a etiqueta passada em ler()
+    function<void(const unsigned char *pixels, int largura, int altura, const string &etiqueta)> entregar;
+    int esperasFence = 0; // Vezes que um PBO ainda estava em uso quando a vez dele voltou
+
+    // Pede a cópia do framebuffer 'fbo' para o próximo PBO do anel
+    void ler(GLuint fbo, int largura, int altura, const string &etiqueta)
+    {
+        coletar(false);
+        Leitura &leitura = leituras[proxima];
+        if (leitura.fence) // A GPU está mais de NUM_PBOS frames atrás: não há como evitar a espera
+        {
+            esperasFence++;
+            concluirLeitura(leitura, true);
+        }
+        GLsizeiptr bytes = (GLsizeiptr)largura * altura * 4;
+        if (!leitura.pbo)
+            glGenBuffers(1, &leitura.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, leitura.pbo);
+        if (leitura.capacidade != bytes) // Primeiro uso ou a resolução interna mudou
+        {
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+            leitura.capacidade = bytes;
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glReadPixels(0, 0, largura, altura, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid *)0); // Linhas de 4*largura bytes: alinhamento padrão
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        leitura.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        leitura.largura = largura;
+        leitura.altura = altura;
+        leitura.etiqueta = etiqueta;
+        proxima = (proxima + 1) % NUM_PBOS;
+    }
+
+    // Entrega as leituras cuja fence já sinalizou, da mais antiga para a mais nova.
+    // Com 'esperar' espera todas (fim da gravação).
+    void coletar(bool esperar)
+    {
+        for (int i = 0; i < NUM_PBOS; i++)
+        {
+            Leitura &leitura = leituras[(proxima + i) % NUM_PBOS];
+            if (leitura.fence && !concluirLeitura(leitura, esperar))
+                return; // As mais novas também não terminaram
+        }
+    }
+
+    // Apaga os PBOs (depois de coletar(true); precisa do contexto GL)
+    void destruir()
+    {
+        for (Leitura &leitura : leituras)
+        {
+            if (leitura.pbo)
+                glDeleteBuffers(1, &leitura.pbo);
+            leitura = Leitura();
+        }
+    }
+
+private:
+    struct Leitura
+    {
+        GLuint pbo = 0;
+        GLsizeiptr capacidade = 0; // Bytes alocados no PBO
+        GLsync fence = 0;          // Sinaliza quando o glReadPixels terminou (0 = livre)
+        int largura = 0, altura = 0;
+        string etiqueta;
+    };
+
+    Leitura leituras[NUM_PBOS];
+    int proxima = 0; // Próximo PBO do anel (também o mais antigo em voo)
+
+    // Mapeia o PBO e entrega a imagem; retorna false se a GPU ainda não terminou (sem 'esperar')
+    bool concluirLeitura(Leitura &leitura, bool esperar)
+    {
+        GLenum resultado = glClientWaitSync(leitura.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (esperar && resultado == GL_TIMEOUT_EXPIRED)
+            resultado = glClientWaitSync(leitura.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        if (resultado == GL_TIMEOUT_EXPIRED)
+            return false;
+        glDeleteSync(leitura.fence);
+        leitura.fence = 0;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, leitura.pbo);
+        const unsigned char *dados = (const unsigned char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, leitura.capacidade, GL_MAP_READ_BIT);
+        if (dados)
+        {
+            entregar(dados, leitura.largura, leitura.altura, leitura.etiqueta);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        else
+            cerr << "Falha ao mapear o PBO da leitura " << leitura.etiqueta << endl;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return true;
+    }
+};
+
+// Capturas em PNG (tecla C, clipes): as leituras passam pelo anel de PBOs e a codificação PNG, a parte
+// cara, fica com threads de trabalho. A thread principal só copia os pixels; inverter as linhas e
+// codificar é trabalho das threads.
+class CapturaFrames
+{
+public:
+    static const size_t MAX_BYTES_NA_FILA = 64 << 20; // Pixels esperando codificação (limita a memória; acima disto descarta)
+
+    AnelLeituraPixels anel;   // Leituras do alvo em voo
+    int descartados = 0;      // Frames perdidos com a fila de codificação cheia
+    atomic<int> gravados{0};  // PNGs já escritos
+
+    // Cria as threads que codificam os PNGs (os PBOs são criados na primeira leitura)
+    void iniciar(int threads)
+    {
+        anel.entregar = [this](const unsigned char *pixels, int largura, int altura, const string &caminho)
+        { enfileirar(pixels, largura, altura, caminho); };
+        for (int i = 0; i < glm::max(1, threads); i++)
+            trabalhadores.emplace_back(&CapturaFrames::executarTrabalhador, this);
+    }
+
+    // Termina as leituras pendentes, espera a fila esvaziar e encerra as threads (precisa do contexto GL)
+    void encerrar()
+    {
+        anel.coletar(true);
+        {
+            lock_guard<mutex> bloqueio(trava);
+            sair = true;
+        }
+        sinalImagem.notify_all();
+        for (thread &trabalhador : trabalhadores)
+            trabalhador.join();
+        trabalhadores.clear();
+        anel.destruir();
+    }
+
+    // Pede a cópia do framebuffer 'fbo'; a imagem vai para 'caminho' quando chegar
+    void lerFramebuffer(GLuint fbo, int largura, int altura, const string &caminho)
+    {
+        anel.ler(fbo, largura, altura, caminho);
+    }
+
+    // Sem GPU (modo software) a imagem já está na memória: vai direto para a fila
+    void copiarImagem(const uint32_t *pixels, int largura, int altura, const string &caminho)
+    {
+        enfileirar((const unsigned char *)pixels, largura, altura, caminho);
+    }
+
+    int imagensNaFila()
+    {
+        lock_guard<mutex> bloqueio(trava);
+        return (int)fila.size();
+    }
+
+private:
+    struct Imagem
+    {
+        vector<unsigned char> pixels; // RGBA8 como foi lido (linha 0 embaixo); a thread inverte para o PNG
+        int largura, altura;
+        string caminho;
+    };
+
+    deque<Imagem> fila;     // Imagens esperando uma thread, na ordem de chegada
+    size_t bytesNaFila = 0; // Pixels das imagens na fila e em codificação (protegido por 'trava')
+    vector<thread> trabalhadores;
+    mutex trava;
+    condition_variable sinalImagem;
+    bool sair = false;
+
+    // Copia a imagem (linha 0 embaixo, como o OpenGL) para a fila das threads, numa única cópia contínua.
+    // Os bytes são reservados antes da cópia: com a fila cheia o frame é descartado sem copiar nada.
+    void enfileirar(const unsigned char *pixels, int largura, int altura, const string &caminho)
+    {
+        size_t bytes = (size_t)largura * altura * 4;
+        {
+            lock_guard<mutex> bloqueio(trava);
+            if (bytesNaFila + bytes > MAX_BYTES_NA_FILA)
+            {
+                descartados++;
+                return;
+            }
+            bytesNaFila += bytes;
+        }
+        Imagem imagem;
+        imagem.largura = largura;
+        imagem.altura = altura;
+        imagem.caminho = caminho;
+        imagem.pixels.assign(pixels, pixels + bytes);
+        {
+            lock_guard<mutex> bloqueio(trava);
+            fila.push_back(std::move(imagem));
+        }
+        sinalImagem.notify_one();
+    }
+
+    // Inverte as linhas no lugar: o PNG começa pela linha de cima
+    static void inverterLinhas(Imagem &imagem)
+    {
+        size_t bytesLinha = (size_t)imagem.largura * 4;
+        vector<unsigned char> temporaria(bytesLinha);
+        for (int y = 0; y < imagem.altura / 2; y++)
+        {
+            unsigned char *cima = &imagem.pixels[y * bytesLinha];
+            unsigned char *baixo = &imagem.pixels[(imagem.altura - 1 - y) * bytesLinha];
+            memcpy(temporaria.data(), cima, bytesLinha);
+            memcpy(cima, baixo, bytesLinha);
+            memcpy(baixo, temporaria.data(), bytesLinha);
+        }
+    }
+
+    void executarTrabalhador()
+    {
+        while (true)
+        {
+            Imagem imagem;
+            {
+                unique_lock<mutex> bloqueio(trava);
+                sinalImagem.wait(bloqueio, [this] { return sair || !fila.empty(); });
+                if (fila.empty()) // Só sai depois de gravar tudo o que foi pedido
+                    return;
+                imagem = std::move(fila.front());
+                fila.pop_front();
+            }
+            inverterLinhas(imagem);
+            if (stbi_write_png(imagem.caminho.c_str(), imagem.largura, imagem.altura, 4, imagem.pixels.data(), imagem.largura * 4))
+                gravados++;
+            else
+                cerr << "Falha ao gravar a captura " << imagem.caminho << endl;
+            lock_guard<mutex> bloqueio(trava);
+            bytesNaFila -= imagem.pixels.size(); // Gravada: a imagem deixa de contar na cota da fila
+        }
+    }
+};
+
+#if RASTERIZADOR_SSE2
+// Soma ponderada dos canais de 4 pixels RGBA8: ((c0*R + c1*G + c2*B + 128) >> 8) + deslocamento, em 32 bits
+static inline __m128i combinarCanaisSse(__m128i rgba, __m128i coeficientes, int deslocamento)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i baixo = _mm_madd_epi16(_mm_unpacklo_epi8(rgba, zero), coeficientes); // [c0R+c1G, c2B] dos pixels 0 e 1
+    __m128i alto = _mm_madd_epi16(_mm_unpackhi_epi8(rgba, zero), coeficientes);  // Pixels 2 e 3
+    __m128 b = _mm_castsi128_ps(baixo), a = _mm_castsi128_ps(alto);
+    __m128i soma = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(b, a, _MM_SHUFFLE(2, 0, 2, 0))),
+                                 _mm_castps_si128(_mm_shuffle_ps(b, a, _MM_SHUFFLE(3, 1, 3, 1))));
+    return _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(soma, _mm_set1_epi32(128)), 8), _mm_set1_epi32(deslocamento));
+}
+#endif
+
+// Média de dois bytes arredondada para cima (a mesma conta do pavgb)
+inline int mediaByte(int a, int b)
+{
+    return (a + b + 1) >> 1;
+}
+
+// Converte RGBA8 (linha 0 embaixo, como o OpenGL) em YUV 4:2:0 planar (I420), BT.601 de faixa limitada:
+//   Y = ((66R + 129G + 25B + 128) >> 8) + 16
+//   U = ((-38R - 74G + 112B + 128) >> 8) + 128,  V = ((112R - 94G - 18B + 128) >> 8) + 128
+// com U e V da média de cada bloco 2x2 (primeiro na vertical, depois na horizontal). O SSE2 faz 16 pixels
+// de luma e 4 amostras de croma por passo; as sobras seguem no laço escalar com a mesma aritmética
+// inteira, então o resultado é idêntico byte a byte com ou sem SIMD.
+void converterRgbaParaI420(const unsigned char *rgba, int largura, int altura, unsigned char *planos)
+{
+    int larguraCroma = (largura + 1) / 2, alturaCroma = (altura + 1) / 2;
+    unsigned char *planoY = planos;
+    unsigned char *planoU = planoY + (size_t)largura * altura;
+    unsigned char *planoV = planoU + (size_t)larguraCroma * alturaCroma;
+    auto linhaOrigem = [&](int y) { return rgba + (size_t)(altura - 1 - glm::min(y, altura - 1)) * largura * 4; };
+
+    for (int y = 0; y < altura; y++)
+    {
+        const unsigned char *origem = linhaOrigem(y);
+        unsigned char *destino = planoY + (size_t)y * largura;
+        int x = 0;
+#if RASTERIZADOR_SSE2
+        const __m128i coeficientesY = _mm_setr_epi16(66, 129, 25, 0, 66, 129, 25, 0);
+        for (; x + 16 <= largura; x += 16)
+        {
+            const __m128i *p = (const __m128i *)(origem + x * 4);
+            __m128i y0 = combinarCanaisSse(_mm_loadu_si128(p), coeficientesY, 16);
+            __m128i y1 = combinarCanaisSse(_mm_loadu_si128(p + 1), coeficientesY, 16);
+            __m128i y2 = combinarCanaisSse(_mm_loadu_si128(p + 2), coeficientesY, 16);
+            __m128i y3 = combinarCanaisSse(_mm_loadu_si128(p + 3), coeficientesY, 16);
+            _mm_storeu_si128((__m128i *)(destino + x), _mm_packus_epi16(_mm_packs_epi32(y0, y1), _mm_packs_epi32(y2, y3)));
+        }
+#endif
+        for (; x < largura; x++)
+        {
+            const unsigned char *p = origem + x * 4;
+            destino[x] = (unsigned char)(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+        }
+    }
+
+    for (int cy = 0; cy < alturaCroma; cy++)
+    {
+        const unsigned char *cima = linhaOrigem(2 * cy), *baixo = linhaOrigem(2 * cy + 1); // Altura ímpar repete a última linha
+        unsigned char *destinoU = planoU + (size_t)cy * larguraCroma, *destinoV = planoV + (size_t)cy * larguraCroma;
+        int cx = 0;
+#if RASTERIZADOR_SSE2
+        const __m128i coeficientesU = _mm_setr_epi16(-38, -74, 112, 0, -38, -74, 112, 0);
+        const __m128i coeficientesV = _mm_setr_epi16(112, -94, -18, 0, 112, -94, -18, 0);
+        for (; 2 * cx + 8 <= largura; cx += 4)
+        {
+            // Média vertical dos 8 pixels e depois dos vizinhos horizontais (pares nas posições 0 e 2 de cada metade)
+            __m128i m0 = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(cima + cx * 8)), _mm_loadu_si128((const __m128i *)(baixo + cx * 8)));
+            __m128i m1 = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(cima + cx * 8 + 16)), _mm_loadu_si128((const __m128i *)(baixo + cx * 8 + 16)));
+            m0 = _mm_avg_epu8(m0, _mm_srli_si128(m0, 4));
+            m1 = _mm_avg_epu8(m1, _mm_srli_si128(m1, 4));
+            __m128i blocos = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(m0), _mm_castsi128_ps(m1), _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i u = combinarCanaisSse(blocos, coeficientesU, 128);
+            __m128i v = combinarCanaisSse(blocos, coeficientesV, 128);
+            __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(u, v), _mm_setzero_si128()); // U0..U3 V0..V3
+            uint32_t quatroU = (uint32_t)_mm_cvtsi128_si32(bytes), quatroV = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(bytes, 4));
+            memcpy(destinoU + cx, &quatroU, 4);
+            memcpy(destinoV + cx, &quatroV, 4);
+        }
+#endif
+        for (; cx < larguraCroma; cx++)
+        {
+            int x0 = 2 * cx, x1 = glm::min(2 * cx + 1, largura - 1); // Largura ímpar repete a última coluna
+            int m[3];
+            for (int c = 0; c < 3; c++)
+                m[c] = mediaByte(mediaByte(cima[x0 * 4 + c], baixo[x0 * 4 + c]), mediaByte(cima[x1 * 4 + c], baixo[x1 * 4 + c]));
+            destinoU[cx] = (unsigned char)(((-38 * m[0] - 74 * m[1] + 112 * m[2] + 128) >> 8) + 128);
+            destinoV[cx] = (unsigned char)(((112 * m[0] - 94 * m[1] - 18 * m[2] + 128) >> 8) + 128);
+        }
+    }
+}
+
+// Gravação de vídeo em fluxo contínuo: cada frame passa pelo anel de PBOs e uma thread converte para
+// YUV 4:2:0 e escreve no arquivo ou no pipe (Y4M), ou escreve o RGBA cru. Uma thread só mantém a ordem
+// dos frames; a fila é curta e, se o disco ou o pipe não acompanharem, o laço espera em vez de descartar
+// (com o relógio virtual o vídeo continua igual, só demora mais para ser gerado).
+class GravadorVideo
+{
+public:
+    static const int MAX_QUADROS_NA_FILA = 8; // Frames lidos esperando a thread
+
+    int largura = 0, altura = 0; // Tamanho fixado pelo primeiro frame (o Y4M não muda de tamanho)
+    int esperasFila = 0;         // Frames em que o laço teve de esperar a thread
+    int descartados = 0;         // Frames de outro tamanho (janela redimensionada, troca de qualidade)
+    atomic<int> gravados{0};     // Frames já escritos
+
+    // Abre o destino ("-" = saída padrão) e cria a thread de conversão
+    bool abrir(const string &caminho, bool formatoY4M, int quadrosPorSegundo)
+    {
+        y4m = formatoY4M;
+        fps = quadrosPorSegundo;
+        if (caminho == "-")
+        {
+            // O vídeo fica com o descritor original da saída padrão; as mensagens do jogo passam a ir para o stderr
+            fflush(stdout);
+#ifdef _WIN32
+            _setmode(_fileno(stdout), _O_BINARY);
+            arquivo = _fdopen(_dup(_fileno(stdout)), "wb");
+            _dup2(_fileno(stderr), _fileno(stdout));
+#else
+            signal(SIGPIPE, SIG_IGN); // Leitor do pipe fechou: o fwrite falha em vez de matar o jogo
+            arquivo = fdopen(dup(fileno(stdout)), "wb");
+            dup2(fileno(stderr), fileno(stdout));
+#endif
+        }
+        else
+            arquivo = fopen(caminho.c_str(), "wb");
+        if (!arquivo)
+        {
+            cerr << "Falha ao abrir o vídeo " << caminho << endl;
+            return false;
+        }
+        anel.entregar = [this](const unsigned char *pixels, int larguraImagem, int alturaImagem, const string &)
+        { enfileirar(pixels, larguraImagem, alturaImagem); };
+        trabalhador = thread(&GravadorVideo::executarTrabalhador, this);
+        return true;
+    }
+
+    bool ativo() const
+    {
+        return arquivo != nullptr;
+    }
+
+    // Pede a leitura do framebuffer 'fbo' como próximo frame do vídeo
+    void lerFramebuffer(GLuint fbo, int larguraImagem, int alturaImagem)
+    {
+        if (tamanhoAceito(larguraImagem, alturaImagem))
+            anel.ler(fbo, larguraImagem, alturaImagem, string());
+        else
+            anel.coletar(false);
+    }
+
+    // Sem GPU (modo software) a imagem já está na memória
+    void copiarImagem(const uint32_t *pixels, int larguraImagem, int alturaImagem)
+    {
+        if (tamanhoAceito(larguraImagem, alturaImagem))
+            enfileirar((const unsigned char *)pixels, larguraImagem, alturaImagem);
+    }
+
+    // Grava os frames pendentes e fecha o destino (precisa do contexto GL)
+    void fechar()
+    {
+        if (!arquivo)
+            return;
+        anel.coletar(true);
+        {
+            lock_guard<mutex> bloqueio(trava);
+            sair = true;
+        }
+        sinalQuadro.notify_all();
+        trabalhador.join();
+        anel.destruir();
+        fclose(arquivo);
+        arquivo = nullptr;
+    }
+
+private:
+    AnelLeituraPixels anel;
+    FILE *arquivo = nullptr;
+    bool y4m = true;
+    int fps = 60;
+    bool falhou = false; // Escrita falhou (disco cheio, pipe fechado): os próximos frames são ignorados
+
+    deque<vector<unsigned char>> fila;  // Frames RGBA8 (linha 0 embaixo) na ordem do vídeo
+    vector<vector<unsigned char>> livres; // Buffers já alocados para reaproveitar
+    thread trabalhador;
+    mutex trava;
+    condition_variable sinalQuadro, sinalEspaco;
+    bool sair = false;
+
+    bool tamanhoAceito(int larguraImagem, int alturaImagem)
+    {
+        if (largura == 0)
+        {
+            largura = larguraImagem;
+            altura = alturaImagem;
+        }
+        if (larguraImagem == largura && alturaImagem == altura)
+            return true;
+        descartados++;
+        return false;
+    }
+
+    // Copia o frame para um buffer livre e entrega à thread (espera se a fila estiver cheia)
+    void enfileirar(const unsigned char *pixels, int larguraImagem, int alturaImagem)
+    {
+        vector<unsigned char> quadro;
+        {
+            unique_lock<mutex> bloqueio(trava);
+            if (fila.size() >= MAX_QUADROS_NA_FILA)
+            {
+                esperasFila++;
+                sinalEspaco.wait(bloqueio, [this] { return fila.size() < MAX_QUADROS_NA_FILA; });
+            }
+            if (!livres.empty())
+            {
+                quadro = std::move(livres.back());
+                livres.pop_back();
+            }
+        }
+        quadro.assign(pixels, pixels + (size_t)larguraImagem * alturaImagem * 4);
+        {
+            lock_guard<mutex> bloqueio(trava);
+            fila.push_back(std::move(quadro));
+        }
+        sinalQuadro.notify_one();
+    }
+
+    bool escrever(const void *dados, size_t bytes)
+    {
+        if (!falhou && fwrite(dados, 1, bytes, arquivo) != bytes)
+        {
+            cerr << "Falha ao escrever o vídeo: gravação interrompida" << endl;
+            falhou = true;
+        }
+        return !falhou;
+    }
+
+    void executarTrabalhador()
+    {
+        vector<unsigned char> saida;
+        if (y4m) // Cabeçalho com o tamanho do primeiro frame; croma no centro de cada bloco 2x2
+        {
+            unique_lock<mutex> bloqueio(trava);
+            sinalQuadro.wait(bloqueio, [this] { return sair || !fila.empty(); });
+        }
+        if (y4m && largura > 0)
+        {
+            char cabecalho[128];
+            int bytes = snprintf(cabecalho, sizeof(cabecalho), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", largura, altura, fps);
+            escrever(cabecalho, bytes);
+        }
+        while (true)
+        {
+            vector<unsigned char> quadro;
+            {
+                unique_lock<mutex> bloqueio(trava);
+                sinalQuadro.wait(bloqueio, [this] { return sair || !fila.empty(); });
+                if (fila.empty()) // Só sai depois de escrever tudo o que foi lido
+                    return;
+                quadro = std::move(fila.front());
+                fila.pop_front();
+            }
+            sinalEspaco.notify_one();
+
+            if (y4m)
+            {
+                size_t bytesCroma = (size_t)((largura + 1) / 2) * ((altura + 1) / 2);
+                saida.resize((size_t)largura * altura + 2 * bytesCroma);
+                converterRgbaParaI420(quadro.data(), largura, altura, saida.data());
+                if (escrever("FRAME\n", 6) && escrever(saida.data(), saida.size()))
+                    gravados++;
+            }
+            else
+            {
+                // RGBA cru, de cima para baixo
+                size_t bytesLinha = (size_t)largura * 4;
+                bool ok = true;
+                for (int y = altura - 1; y >= 0 && ok; y--)
+                    ok = escrever(&quadro[y * bytesLinha], bytesLinha);
+                if (ok)
+                    gravados++;
+            }
+            lock_guard<mutex> bloqueio(trava);
+            livres.push_back(std::move(quadro));
+        }
+    }
+};
+
+// classes de funções (declarações antes da implementação)
+void tecladoCallbackMenu(GLFWwindow *janela, int tecla, int scancode, int acao, int modo);
+void mouseCallbackMenu(GLFWwindow *janela, int botao, int acao, int mods);
+void cursorCallbackMenu(GLFWwindow *janela, double xpos, double ypos);
+void redesenharCallback(GLFWwindow *janela);
+ProgramaShader configurarShader(const GLchar *codigoVertex, const GLchar *codigoFragment);
+ShaderSprite &obterVarianteShader(uint32_t recursos);
+template <uint32_t RECURSOS>
+ShaderSprite &varianteShader();
+int configurarSprite();
+int configurarSpriteInstanciado();
+void iniciarAnimacao(Sprite &sprite, int animacao);
+GLuint criarTextura2D(const unsigned char *dados, int largura, int altura, int canais, GLenum repeticao, GLenum filtro,
+                      PoliticaMipmap mipmaps);
+int carregarTextura(string caminhoArquivo, bool *translucida = nullptr, PoliticaMipmap mipmaps = SEM_MIPMAPS);
+int indexarCores(const unsigned char *dados, int numPixels, int nrCanais, vector<unsigned char> &indices,
+                 vector<unsigned char> &paleta);
+GLuint criarTexturaIndexada(const vector<unsigned char> &indices, const vector<unsigned char> &paleta, int largura, int altura,
+                            GLenum repeticao);
+GLuint paletaDaTextura(GLuint textura);
+void gerarVariantesPaleta(vector<unsigned char> &paleta, int linhas);
+bool imagemTranslucida(const unsigned char *dados, int numPixels, int nrCanais);
+bool construirAtlas(AtlasTexturas &atlas, const vector<string> &caminhos);
+void aplicarEntradaAtlas(Sprite &sprite, int entrada);
+void marcarEntradaAtlasUsada(int entrada);
+DadosInstancia montarInstancia(const Sprite &sprite);
+template <uint32_t RECURSOS>
+void enfileirarSprite(const Sprite &sprite, CamadaRender camada);
+QuadSoftware quadDaInstancia(const DadosInstancia &instancia, GLuint textura, uint32_t recursos, bool translucido);
+void submeterFilaRender();
+void lerContagemFragmentos();
+void apontarAtributosInstancia(GLintptr base);
+void contarBindsEvitadosAtlas();
+template <uint32_t RECURSOS>
+void drawSprite(const Sprite &sprite, vec4 cor = vec4(1.0f));
+void drawInimigos();
+void adicionarCamadaFundo(GLuint idTextura, vec2 fatorParallax, bool translucida = false);
+void enfileirarFundo();
+bool verificarColisao(const Sprite &a, const Sprite &b);
+void construirMenu();
+void renderizarMenu();
+bool mouseSobreBotao(vec2 posicaoMouse, Botao botao);
+void atualizarBotaoSobMouse(GLFWwindow *janela, double xpos, double ypos);
+void mudarEstadoJogo(EstadoJogo novoEstado);
+void iniciarPartida();
+void redimensionarCallback(GLFWwindow *janela, int largura, int altura);
+bool criarAlvoRender(AlvoRender &alvo, int largura, int altura, int amostras, bool filtroLinear);
+void aplicarNivelQualidade(int nivel);
+void iniciarFrameAlvo();
+void apresentarAlvoRender();
+void limparTela(vec4 cor, GLbitfield buffers);
+void atualizarGovernador();
+void registrarTempoFrame(double tempoMs);
+uint64_t hashFNV1a(const void *dados, size_t tamanho, uint64_t hash = 14695981039346656037ull);
+bool lerCacheFonteSDF(uint64_t hashFonte, vector<unsigned char> &bitmap);
+void salvarCacheFonteSDF(uint64_t hashFonte, const vector<unsigned char> &bitmap);
+bool gerarAtlasFonteSDF(const vector<unsigned char> &arquivoFonte, vector<unsigned char> &bitmap);
+bool carregarFonte(const string &caminho);
+void prepararTexto(const string &texto, TextoPreparado &saida);
+void acrescentarTexto(const TextoPreparado &texto, vec2 posicao, float tamanho, vec4 cor);
+void escreverTexto(const string &texto, vec2 posicao, float tamanho, vec4 cor);
+void escreverTextoFixo(const string &texto, vec2 posicao, float tamanho, vec4 cor, bool centralizar = false);
+void desenharTextos();
+bool lerArgumentos(int argc, char **argv);
+GLFWwindow *criarJanelaHeadless();
+bool salvarImagemAlvo(const string &caminho);
+vector<unsigned char> lerImagemAlvo();
+bool compararImagemAlvo(const string &caminhoReferencia);
+GLuint framebufferLeituraAlvo();
+void capturarFrame();
+void alternarClipe();
+double relogioJogo();
+
+// Constantes de configuração do jogo
+const GLuint LARGURA = 800, ALTURA = 600; // Dimensões da janela
+
+// Configurações de dificuldade e gameplay
+const int NUM_TEXTURAS_CARROS = 4;              // Número de texturas diferentes para carros inimigos
+
+// Entradas do atlas de sprites, na ordem dos arquivos em CAMINHOS_SPRITES_ATLAS (carros inimigos primeiro)
+enum EntradaAtlasSprites
+{
+    ENTRADA_CARRO1,
+    ENTRADA_CARRO2,
+    ENTRADA_CARRO3,
+    ENTRADA_CARRO4,
+    ENTRADA_JOGADOR,
+    ENTRADA_MOEDA,
+    NUM_ENTRADAS_ATLAS_SPRITES
+};
+static_assert(ENTRADA_JOGADOR - ENTRADA_CARRO1 == NUM_TEXTURAS_CARROS, "uma entrada do atlas por textura de carro");
+const char *CAMINHOS_SPRITES_ATLAS[NUM_ENTRADAS_ATLAS_SPRITES] = {
+    "../assets/sprites/carro1.png", "../assets/sprites/carro2.png",
+    "../assets/sprites/carro3.png", "../assets/sprites/carro4.png",
+    "../assets/sprites/player.png", "../assets/sprites/moeda.png"};
+const float VELOCIDADE_INIMIGO_BASE = 2.0f;     // Velocidade inicial dos inimigos
+const float VELOCIDADE_INIMIGO_MAXIMA = 8.0f;   // Velocidade máxima dos inimigos
+const float TAXA_AUMENTO_DIFICULDADE = 0.6f;    // Quanto aumenta a velocidade por segundo
+const float INTERVALO_DIFICULDADE = 8.0f;      // Intervalo para aumentar dificuldade
+const int MAX_INIMIGOS = 1000;                   // Número máximo de inimigos na tela
+const int MAX_COMANDOS_RENDER = MAX_INIMIGOS + 64; // Máximo de sprites enfileirados por frame
+const GLsizeiptr BYTES_ENVIO_TEXTURAS = 2 << 20;  // Região do buffer de envio de texturas por frame (imagens maiores usam um buffer próprio)
+const float INTERVALO_APARICAO_INIMIGOS = 0.2f; // Intervalo entre aparecer novos inimigos
+const float QUADROS_POR_SEGUNDO_JOGADOR = 12.0f; // Velocidade da animação do jogador
+const float ANGULO_CURVA_JOGADOR = 12.0f;       // Inclinação do carro (graus) ao virar
+const float RAPIDEZ_CURVA_JOGADOR = 10.0f;      // Quão rápido a inclinação segue o volante (por segundo)
+const vec4 COR_BATIDA = vec4(1.0f, 0.35f, 0.35f, 1.0f); // Tingimento do carro do jogador depois da batida
+const float VELOCIDADE_ESTRADA_BASE = 1.0f;     // Rolagem da estrada (alturas de tela por segundo) na velocidade inicial do jogo
+const double PERIODO_ROLAGEM = 64.0;            // A distância enviada à GPU volta a zero neste período (precisão do float)
+
+// Profundidades (z em [-1, 1], maior = mais à frente) de cada camada do jogo
+const float PROFUNDIDADE_FUNDO = -0.9f;    // Primeira camada do fundo (as seguintes ficam um pouco à frente)
+const float PROFUNDIDADE_INIMIGOS = 0.0f;  // Carros inimigos
+const float PROFUNDIDADE_JOGADOR = 0.5f;   // Carro do jogador
+
+// Governador de qualidade
+const int NIVEL_QUALIDADE_INICIAL = 2;          // 100% sem MSAA; o governador sobe ou desce a partir daqui
+const int FRAMES_PARA_REDUZIR = 30;             // Medições seguidas acima do orçamento antes de reduzir
+const int FRAMES_PARA_AUMENTAR = 180;           // Medições com folga antes de aumentar (evita oscilar)
+const double FRACAO_REDUZIR = 0.9;              // Reduz quando a média passa desta fração do orçamento
+const double FRACAO_AUMENTAR = 0.5;             // Aumenta quando a média fica abaixo desta fração
+
+// Ritmo dos frames
+const ModoRitmo MODO_RITMO_INICIAL = RITMO_VSYNC; // Modo ao abrir o jogo
+const double LIMITE_FPS = 60.0;                   // Frequência dos modos limitado e baixa latência
+
+// Execução sem janela (--headless)
+const int FRAMES_HEADLESS_PADRAO = 600;           // Frames desenhados quando --frames não é informado
+const char *FORMATO_ARQUIVO_CAPTURA = "captura_%03d.png"; // Tecla C (número da captura)
+const char *FORMATO_ARQUIVO_CLIPE = "clipe%02d_%05d.png"; // Tecla K e --capturar (número do clipe, quadro)
+const int MAX_THREADS_CAPTURA = 4;                // Threads que codificam PNG (uma por núcleo livre, até este limite)
+const int FPS_VIDEO_PADRAO = 60;                  // Passo do relógio virtual quando --video-fps não é informado
+const unsigned int SEMENTE_VIDEO = 1;             // Semente do rand() no relógio virtual sem --semente (execuções repetíveis)
+const int TOLERANCIA_COMPARACAO = 8;              // --comparar: diferença por canal aceita em cada pixel (arredondamento)
+const double FRACAO_MAXIMA_FORA_TOLERANCIA = 0.005; // --comparar: pixels que podem passar da tolerância (bordas
+                                                    // de sprites e do texto suavizado rasterizam diferente)
+
+// Rasterizador em software
+#if RASTERIZADOR_AVX2
+const char *NOME_SIMD_RASTERIZADOR = "AVX2";
+#elif RASTERIZADOR_SSE2
+const char *NOME_SIMD_RASTERIZADOR = "SSE2";
+#else
+const char *NOME_SIMD_RASTERIZADOR = "escalar";
+#endif
+
+// Texto do HUD
+const float TAMANHO_FONTE_ATLAS = 32.0f;       // Altura em pixels dos caracteres no atlas SDF (serve para qualquer tamanho)
+const int MARGEM_SDF = 4;                      // Pixels de distância guardados fora do contorno de cada caractere
+const unsigned char VALOR_BORDA_SDF = 128;     // Valor do atlas exatamente sobre o contorno
+const int LARGURA_ATLAS_FONTE = 512;           // Largura do atlas da fonte
+const int ALTURA_INICIAL_ATLAS_FONTE = 256, ALTURA_MAXIMA_ATLAS_FONTE = 1024; // A altura dobra se os caracteres não couberem
+const char *CAMINHO_CACHE_FONTE_SDF = "fonte_sdf.cache"; // Atlas SDF já gerado (vale para a mesma fonte)
+const char *CAMINHO_CACHE_PROGRAMAS = "programas.cache"; // Binários dos programas de shader (valem para o mesmo driver)
+const uint32_t TAMANHO_MAXIMO_BINARIO = 64 << 20;      // Entradas maiores no cache são tratadas como arquivo corrompido
+const int PRIMEIRO_CARACTERE = 32, NUM_CARACTERES = 96;         // ASCII imprimível (espaço até '~')
+const int MAX_CARACTERES_TEXTO = 4096;         // Caracteres desenhados por frame
+const float ESPACAMENTO_LINHAS = 1.25f;        // Distância entre linhas, em alturas da fonte
+const float ALTURA_MAIUSCULAS = 0.7f;          // Altura aproximada das maiúsculas (centraliza rótulos)
+const float TAMANHO_TEXTO_HUD = 20.0f;         // Tempo, FPS e pontos
+const float TAMANHO_TEXTO_ESTATISTICAS = 13.0f; // Contadores de desempenho
+const float TAMANHO_TEXTO_BOTAO = 28.0f;       // Rótulos dos botões do menu
+const float PONTOS_POR_TELA = 100.0f;          // Pontos por altura de tela percorrida na partida
+const char *CAMINHO_FONTE = "../assets/fonts/DejaVuSans.ttf"; // Fonte do HUD e do menu (vem com o jogo)
+
+// Configurações de interface do menu
+const vec2 TAMANHO_BOTAO = vec2(200, 60);              // Tamanho padrão dos botões
+const float OFFSET_Y_BOTAO = 50.0f;                    // Espaçamento vertical entre botões
+const vec3 COR_BOTAO = vec3(0.2f, 0.3f, 0.8f);         // Cor base dos botões
+const vec3 COR_HOVER_INICIAR = vec3(0.0f, 1.0f, 0.5f); // Cor quando mouse está sobre o botão Iniciar
+const vec3 COR_HOVER_SAIR = vec3(1.0f, 0.5f, 0.5f);    // Cor quando mouse está sobre o botão Sair
+
+// Array de botões do menu
+const int NUM_BOTOES = 2;
+Botao botoes[NUM_BOTOES] = {                                                                  
+    {vec2(LARGURA / 2, ALTURA / 2 + OFFSET_Y_BOTAO), TAMANHO_BOTAO, "Iniciar", vec3(0.0f, 1.0f, 0.0f)}, // Botão Iniciar (vermelho)
+    {vec2(LARGURA / 2, ALTURA / 2 - OFFSET_Y_BOTAO), TAMANHO_BOTAO, "Sair", vec3(1.0f, 0.0f, 0.0f)}};   // Botão Sair (roxo)
+
+// Menu em modo retido: os sprites dos botões são criados uma vez e o destaque só muda pelos
+// callbacks do cursor. Menu e fim de jogo são telas paradas, redesenhadas só quando algo muda.
+struct CamadaMenu
+{
+    Sprite botoes[NUM_BOTOES]; // Um sprite por botão, todos com o mesmo VAO
+    int botaoSobMouse = -1;    // Botão destacado (-1 = nenhum)
+};
+CamadaMenu camadaMenu;
+bool telaAlterada = true;       // Algo mudou desde o último desenho da tela parada
+double instanteFimDeJogo = 0.0; // Quando a batida aconteceu
+
+const double TEMPO_FIM_DE_JOGO = 1.0;         // Segundos na tela de fim de jogo antes de voltar ao menu
+const double ESPERA_MAXIMA_TELA_PARADA = 0.5; // Prazo do glfwWaitEventsTimeout no menu
+const float DELTA_MAXIMO = 0.1f;              // Limita o passo do primeiro frame depois de dormir no menu
+
+// Código fonte dos shaders (programas que rodam na GPU).
+// Sem a linha #version: montarFonteShader acrescenta a versão e os #define da variante.
+const GLchar *codigoFonteVertexShader = R"(
+    layout (location = 0) in vec2 position;
+    layout (location = 1) in vec2 texc;
+#ifdef INSTANCIADO
+    layout (location = 2) in vec3 inst_posicao;
+    layout (location = 3) in vec2 inst_escala;
+    layout (location = 4) in vec2 inst_offset_tex;
+    layout (location = 5) in vec4 inst_uv_rect;
+    layout (location = 6) in vec4 inst_folha_animacao;
+    layout (location = 7) in float inst_inicio_animacao;
+    layout (location = 8) in float inst_angulo;
+    layout (location = 9) in vec2 inst_ancora;
+    layout (location = 10) in vec4 inst_tingimento;
+    layout (location = 11) in float inst_linha_paleta;
+    out vec4 cor_instancia;
+    flat out int linha_paleta;
+#else
+    uniform vec4 posicao_angulo; // xyz: posição, w: rotação em graus
+    uniform vec4 escala_ancora;  // xy: escala, zw: âncora
+    uniform vec2 offset_tex;
+    uniform vec4 uv_rect;
+    uniform vec4 folha_animacao;
+    uniform float inicio_animacao;
+#endif
+
+    layout (std140) uniform ConstantesFrame
+    {
+        mat4 projecao;
+        mat4 visao;
+        vec4 tempo;
+        vec4 escalaRender;
+    };
+#ifdef TEXTURA
+    out vec2 tex_coord;
+#endif
+    void main()
+    {
+#ifdef INSTANCIADO
+        vec3 posicao = inst_posicao;
+        vec2 escala = inst_escala;
+        float angulo = inst_angulo;
+        vec2 ancora = inst_ancora;
+        cor_instancia = inst_tingimento;
+        linha_paleta = int(inst_linha_paleta);
+        vec2 deslocamento = inst_offset_tex;
+        vec4 retangulo = inst_uv_rect;
+        vec4 folha = inst_folha_animacao;
+        float inicio = inst_inicio_animacao;
+#else
+        vec3 posicao = posicao_angulo.xyz;
+        vec2 escala = escala_ancora.xy;
+        float angulo = posicao_angulo.w;
+        vec2 ancora = escala_ancora.zw;
+        vec2 deslocamento = offset_tex;
+        vec4 retangulo = uv_rect;
+        vec4 folha = folha_animacao;
+        float inicio = inicio_animacao;
+#endif
+        // Escala em relação à âncora, gira em torno dela e põe a âncora em 'posicao'
+        vec2 local = (position + 0.5 - ancora) * escala;
+        float seno = sin(radians(angulo)), cosseno = cos(radians(angulo));
+        vec2 girado = vec2(cosseno * local.x - seno * local.y, seno * local.x + cosseno * local.y);
+        vec4 posicaoMundo = vec4(posicao + vec3(girado, 0.0), 1.0);
+#ifdef TEXTURA
+        vec2 uv = vec2(texc.s,1.0-texc.t);
+#ifdef UV_ANIMADO
+        // folha = (quadros, animações, animação atual, quadros por segundo); a linha 0 fica no topo da imagem
+        float quadro = mod(floor(max(tempo.x - inicio, 0.0) * folha.w), folha.x);
+        uv = (uv + vec2(quadro, folha.z)) / folha.xy;
+#endif
+#ifdef ROLAGEM
+        uv -= deslocamento * tempo.z; // deslocamento = fator de parallax da camada
+#endif
+        tex_coord = retangulo.xy + uv * retangulo.zw;
+#endif
+        gl_Position = projecao * visao * posicaoMundo;
+    }
+)"; // Vertex Shader (processa vértices)
+const GLchar *fragmentShaderSource = R"(
+#ifdef TEXTURA
+    in vec2 tex_coord;
+    uniform sampler2D tex_buff;
+#endif
+#ifdef PALETA
+    uniform sampler2D paleta; // Uma linha de cores por variante da textura indexada
+#ifdef INSTANCIADO
+    flat in int linha_paleta; // Variante de cor da instância
+#else
+    uniform int linha_paleta;
+#endif
+#endif
+#ifdef COR_SOLIDA
+    uniform vec3 solidColor;
+#endif
+#ifdef TINGIMENTO
+    uniform vec4 tint;
+#endif
+#ifdef INSTANCIADO
+    in vec4 cor_instancia; // Tingimento por instância (sempre aplicado: não separa lotes)
+#endif
+    out vec4 color;
+
+    void main()
+    {
+#ifdef COR_SOLIDA
+        color = vec4(solidColor, 1.0);
+#elif defined(PALETA)
+        // Índice da cor em [0, 1] (GL_NEAREST: índices vizinhos nunca se misturam)
+        int indice = int(texture(tex_buff, tex_coord).r * 255.0 + 0.5);
+        color = texelFetch(paleta, ivec2(indice, linha_paleta), 0);
+#else
+        color = texture(tex_buff, tex_coord);
+#endif
+#ifdef TINGIMENTO
+        color *= tint;
+#endif
+#ifdef INSTANCIADO
+        color *= cor_instancia;
+#endif
+#ifdef RECORTE
+        if (color.a < 0.5)
+            discard;
+#endif
+#ifdef SOBREPOSICAO
+        color = vec4(0.12, 0.06, 0.02, 1.0); // Cada fragmento soma um pouco de "calor"
+#endif
+    }
+)"; // Fragment Shader (processa pixels)
+
+// Texto do HUD: vértices já no mundo do jogo; o atlas guarda a distância até o contorno de cada caractere
+const GLchar *codigoFonteVertexTexto = R"(
+    #version 400
+    layout (location = 0) in vec2 position;
+    layout (location = 1) in vec2 texc;
+    layout (location = 2) in vec4 cor;
+    layout (std140) uniform ConstantesFrame
+    {
+        mat4 projecao;
+        mat4 visao;
+        vec4 tempo;
+        vec4 escalaRender;
+    };
+    out vec2 tex_coord;
+    out vec4 cor_texto;
+    void main()
+    {
+        tex_coord = texc;
+        cor_texto = cor;
+        gl_Position = projecao * vec4(position, 0.0, 1.0);
+    }
+)";
+const GLchar *codigoFonteFragmentTexto = R"(
+    #version 400
+    in vec2 tex_coord;
+    in vec4 cor_texto;
+    uniform sampler2D tex_buff;
+    out vec4 color;
+    void main()
+    {
+        // Contorno em 0.5; a transição dura ~1 pixel da tela em qualquer tamanho ou escala de render
+        float distancia = texture(tex_buff, tex_coord).r;
+        float suavizacao = max(fwidth(distancia) * 0.7, 1e-4);
+        float cobertura = smoothstep(0.5 - suavizacao, 0.5 + suavizacao, distancia);
+        color = vec4(cor_texto.rgb, cor_texto.a * cobertura);
+    }
+)";
+
+// Apresentação do alvo interno: um triângulo que cobre a tela, gerado a partir de gl_VertexID
+const GLchar *codigoFonteVertexApresentacao = R"(
+    #version 400
+    out vec2 tex_coord;
+    void main()
+    {
+        vec2 canto = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        tex_coord = canto;
+        gl_Position = vec4(canto * 2.0 - 1.0, 0.0, 1.0);
+    }
+)";
+const GLchar *codigoFonteFragmentApresentacao = R"(
+    #version 400
+    in vec2 tex_coord;
+    uniform sampler2D tex_buff;
+    out vec4 color;
+    void main()
+    {
+        color = texture(tex_buff, tex_coord);
+    }
+)";
+
+// configuraçoes fixas
+bool teclas[1024];                         // Array para estado das teclas (pressionadas ou não)
+GLuint VAOTexto;                           // VAO do texto (atributos apontam para bufferTexto)
+BufferStreaming bufferTexto;               // Vértices do texto reescritos a cada frame
+GLuint texturaFonte;                       // Atlas da fonte (um canal)
+stbtt_bakedchar dadosCaracteres[NUM_CARACTERES]; // Retângulo no atlas SDF, deslocamento e avanço de cada caractere
+int larguraAtlasFonte = 0, alturaAtlasFonte = 0; // Dimensões do atlas SDF
+ProgramaShader programaTexto;              // Desenha o texto do HUD
+bool fonteCarregada = false;               // Sem fonte o HUD volta para o título da janela
+vector<VerticeTexto> verticesTexto;        // Texto do frame, enviado em um draw por desenharTextos
+unordered_map<string, TextoPreparado> cacheTextos; // Textos fixos já montados
+double distanciaInicioPartida = 0.0;       // distanciaEstrada quando a partida começou (pontuação)
+Sprite inimigos[MAX_INIMIGOS];             // Array de inimigos
+float temporizadorAparecerInimigos = 0.0f; // Contador para aparecer novos inimigos
+Sprite jogador;                            // Sprite do jogador
+const int MAX_CAMADAS_FUNDO = 4;           // Máximo de camadas de parallax do fundo
+Sprite camadasFundo[MAX_CAMADAS_FUNDO];    // Camadas do fundo, da mais distante para a mais próxima
+int numCamadasFundo = 0;                   // Camadas do fundo em uso
+double distanciaEstrada = 0.0;             // Distância percorrida, em alturas de tela
+float velocidadeJogo = VELOCIDADE_INIMIGO_BASE; // Velocidade atual dos inimigos; a estrada rola na mesma proporção
+bool usarCamadasProfundidade = true;       // Opacos na frente-para-trás com depth test; P volta ao blending de tudo
+bool visualizarSobreposicao = false;       // Tecla O: pinta a sobreposição (fragmentos por pixel)
+GLuint consultasFragmentos[2];             // Occlusion queries alternadas (lê a do frame anterior sem travar)
+bool consultaPendente[2] = {false, false}; // A consulta foi emitida e ainda não lida
+int consultaAtual = 0;                     // Consulta usada neste frame
+double sobreposicaoMedia = 0.0;            // Amostras escritas / amostras da tela no último resultado
+AlvoRender alvoRender;                     // Framebuffer fora da tela na resolução interna
+GovernadorQualidade governador;            // Escolhe resolução interna e MSAA pelo tempo de frame
+ProgramaShader programaApresentacao;       // Copia o alvo interno (ampliado) para a janela
+AgendadorFrames agendador;                 // Ritmo do laço principal (tecla V troca o modo)
+bool modoHeadless = false;                 // --headless: sem janela visível, desenha só no alvo interno
+int framesHeadless = FRAMES_HEADLESS_PADRAO; // --frames: quantos frames desenhar antes de sair
+string arquivoSaidaHeadless;               // --saida: PNG com o último frame (vazio = não grava)
+string arquivoComparacao;                  // --comparar: PNG de referência para o último frame (vazio = não compara)
+bool relogioVirtual = false;               // --relogio-virtual, --comparar ou --video: a simulação anda 1/fps por frame
+bool renderSoftware = false;               // --software (ou sem OpenGL 4.0): desenha na CPU com o rasterizador
+int threadsSoftware = 0;                   // --threads: threads do rasterizador (0 = uma por núcleo)
+RasterizadorSoftware rasterizador;         // Imagem, profundidade e texturas do modo software
+CapturaFrames captura;                     // Leituras assíncronas do alvo e gravação dos PNGs
+bool pedidoCapturaTela = false;            // Tecla C: grava o próximo frame desenhado
+bool gravandoClipe = false;                // Tecla K (ou --capturar): grava todos os frames
+int quadrosClipeArgumento = 0;             // --capturar N: grava os N primeiros frames como clipe
+int numeroCaptura = 0, numeroClipe = 0, quadroClipe = 0; // Numeração dos arquivos
+GravadorVideo gravador;                    // --video: frames em Y4M ou RGBA cru, no relógio virtual
+string arquivoVideo;                       // --video: destino ("-" = saída padrão; vazio = sem vídeo)
+string formatoVideo;                       // --video-formato: y4m ou rgba (vazio = pela extensão)
+int fpsVideo = FPS_VIDEO_PADRAO;           // --video-fps: frames por segundo do vídeo e do relógio virtual
+long long quadrosRelogioVirtual = 0;       // Frames simulados desde o início da gravação
+long long sementeAleatoria = -1;           // --semente: semente do rand() (-1 = pelo relógio)
+GLuint VAOApresentacao;                    // VAO vazio: a apresentação não usa atributos
+GLFWwindow *janela;                        // Ponteiro para a janela GLFW
+AtlasTexturas atlasSprites;                // Atlas com os sprites de carros, jogador e moeda
+int entradasCarros[NUM_TEXTURAS_CARROS];   // Entradas dos carros inimigos no atlas
+const int MAX_ENTRADAS_ATLAS = 64;         // Máximo de sprites rastreados no atlas
+bool entradasAtlasUsadas[MAX_ENTRADAS_ATLAS]; // Entradas do atlas desenhadas no frame
+int contadorBindsEvitadosAtlas = 0;        // Trocas de textura que o atlas evitou no último frame
+ShaderSprite variantesShader[NUM_VARIANTES_SHADER]; // Variantes do shader de sprites, compiladas sob demanda
+GLuint VAOInstancias;                      // Geometria compartilhada do desenho instanciado
+BufferStreaming bufferInstancias;          // Buffer de instâncias reescrito a cada frame
+BufferStreaming bufferEnvioTexturas;       // Pixel unpack buffer dos envios de textura
+unordered_map<GLuint, GLuint> paletasTexturas; // Textura indexada (R8) -> textura da sua paleta
+unordered_map<uint64_t, BinarioPrograma> cacheProgramas; // Binários de programa do driver atual, pelo hash dos fontes
+bool cacheProgramasLido = false;           // O arquivo do cache é lido na primeira montagem de programa
+bool cacheProgramasDoDriver = false;       // O arquivo em disco é deste driver e está inteiro (novas entradas vão ao fim)
+int programasDoCache = 0, programasCompilados = 0; // Programas montados de cada jeito
+double tempoProgramasMs = 0.0;             // Tempo gasto montando programas (compilando ou carregando o binário)
+ConstantesFrame constantesFrame;           // Cópia na CPU das constantes do frame
+GLuint UBOConstantesFrame;                 // Uniform buffer com as constantes do frame
+int larguraFramebuffer = LARGURA, alturaFramebuffer = ALTURA; // Tamanho atual do framebuffer da janela
+bool usarInstancing = true;                // Alterna entre juntar comandos em draws instanciados e um draw por sprite (tecla I)
+FilaRender filaRender;                     // Fila de desenho do frame
+int contadorDrawCalls = 0;                 // Draw calls emitidas no frame atual
+int contadorSpritesDesenhados = 0;         // Sprites desenhados no frame atual (draws sem instancing)
+
+// Implementação das funções
+
+// Inicializa os inimigos com texturas aleatórias
+void inicializarInimigos()
+{
+    // Os carros inimigos são as quatro primeiras entradas do atlas
+    for (int i = 0; i < NUM_TEXTURAS_CARROS; i++)
+    {
+        entradasCarros[i] = ENTRADA_CARRO1 + i;
+    }
+
+    // Configura cada inimigo
+    for (int i = 0; i < MAX_INIMIGOS; i++)
+    {
+        inimigos[i].VAO = configurarSprite();
+        int tipoCarro = rand() % NUM_TEXTURAS_CARROS; // Escolhe textura aleatória
+        aplicarEntradaAtlas(inimigos[i], entradasCarros[tipoCarro]);
+        inimigos[i].linhaPaleta = rand() % atlasSprites.linhasPaleta; // E uma das variantes de cor
+        inimigos[i].dimensoes = vec3(100.0f, 100.0f, 1.0f); // Tamanho padrão
+        inimigos[i].posicao = vec3(-100.0f, -100.0f, PROFUNDIDADE_INIMIGOS); // Posição inicial fora da tela
+        inimigos[i].velocidade = VELOCIDADE_INIMIGO_BASE;   // Velocidade inicial
+        inimigos[i].numAnimacoes = 1;                       // Sem animações
+        inimigos[i].numQuadros = 1;                         // Apenas 1 quadro
+        inimigos[i].animacaoAtual = 0;
+    }
+}
+
+// Atualiza a posição e comportamento dos inimigos
+void atualizarInimigos(float deltaTempo)
+{
+    if (estadoJogo != JOGANDO) // Só atualiza se estiver jogando
+        return;
+
+    // Atualiza temporizadores
+    temporizadorAparecerInimigos += deltaTempo;
+    static float tempoJogo = 0.0f;
+    tempoJogo += deltaTempo;
+
+    // Aumenta dificuldade com o tempo
+    float velocidadeInimigoAtual = VELOCIDADE_INIMIGO_BASE + (tempoJogo * TAXA_AUMENTO_DIFICULDADE);
+    if (velocidadeInimigoAtual > VELOCIDADE_INIMIGO_MAXIMA)
+    {
+        velocidadeInimigoAtual = VELOCIDADE_INIMIGO_MAXIMA;
+    }
+    velocidadeJogo = velocidadeInimigoAtual;
+
+    // Aparece novo inimigo se passou o intervalo
+    if (temporizadorAparecerInimigos >= INTERVALO_APARICAO_INIMIGOS)
+    {
+        temporizadorAparecerInimigos = 0.0f;
+        for (int i = 0; i < MAX_INIMIGOS; i++)
+        {
+            // Encontra um inimigo que não está na tela
+            if (inimigos[i].posicao.y < -50.0f)
+            {
+                // Posiciona em um lugar aleatório no topo da tela
+                inimigos[i].posicao.x = 100.0f + static_cast<float>(rand() % 600);
+                inimigos[i].posicao.y = ALTURA + 50.0f;
+                inimigos[i].velocidade = velocidadeInimigoAtual;
+                int tipoCarro = rand() % NUM_TEXTURAS_CARROS;
+                aplicarEntradaAtlas(inimigos[i], entradasCarros[tipoCarro]);
+                inimigos[i].linhaPaleta = rand() % atlasSprites.linhasPaleta;
+                iniciarAnimacao(inimigos[i], 0); // Começa do primeiro quadro
+                break;
+            }
+        }
+    }
+
+    // Move todos os inimigos ativos
+    for (int i = 0; i < MAX_INIMIGOS; i++)
+    {
+        if (inimigos[i].posicao.y > -50.0f) // Se está na tela
+        {
+            inimigos[i].posicao.y -= inimigos[i].velocidade; // Move para baixo
+            if (inimigos[i].posicao.y < -50.0f)              // Saiu da tela
+            {
+                inimigos[i].posicao = vec3(-100.0f, -100.0f, PROFUNDIDADE_INIMIGOS); // Remove
+            }
+        }
+    }
+}
+
+// Enfileira todos os inimigos ativos para desenho
+void drawInimigos()
+{
+    if (estadoJogo != JOGANDO) // Só desenha se estiver jogando
+        return;
+
+    for (int i = 0; i < MAX_INIMIGOS; i++)
+    {
+        if (inimigos[i].posicao.y > -50.0f) // Se está na tela
+        {
+            enfileirarSprite<SPRITE_ANIMADO>(inimigos[i], CAMADA_INIMIGOS);
+        }
+    }
+}
+
+// Troca a animação (linha da folha) e recomeça do primeiro quadro; a GPU conta os quadros
+// a partir do tempo do frame, então não há nada a atualizar por sprite depois disto
+void iniciarAnimacao(Sprite &sprite, int animacao)
+{
+    sprite.animacaoAtual = animacao;
+    sprite.inicioAnimacao = constantesFrame.tempo.x;
+}
+
+// Monta a chave de ordenação. O bit mais alto separa os passes (opacos antes dos translúcidos):
+//   opaco:       0 | camada invertida(7) | shader(8) | textura(16) | profundidade invertida(24) | reservado(8)
+//   fundo opaco: 0 | camada invertida(7) | profundidade(24) | shader(8) | textura(16) | reservado(8)
+//   translúcido: 1 | camada(7) | profundidade(24) | shader(8) | textura(16) | reservado(8)
+// Opacos vão da frente para trás (o early-z descarta o que fica atrás) agrupados por estado;
+// translúcidos vão de trás para frente, como o blending exige. As camadas do fundo também vão de trás
+// para frente pela profundidade, antes da textura: a camada mais distante desenha antes mesmo com
+// texturas diferentes. PALETA e SOBREPOSICAO não entram no campo
+// do shader: são acrescentados no desenho (a paleta é da textura, que já está na chave).
+uint64_t montarChaveRender(CamadaRender camada, int shader, GLuint textura, float profundidade, bool translucido)
+{
+    // Profundidade em [-1, 1] (mesmo intervalo da projeção) quantizada para 24 bits
+    float z = glm::clamp((profundidade + 1.0f) * 0.5f, 0.0f, 1.0f);
+    uint64_t zQuantizado = (uint64_t)(z * 16777215.0f);
+    if (translucido)
+        return (1ull << 63) |
+               ((uint64_t)(camada & 0x7F) << 56) |
+               (zQuantizado << 32) |
+               ((uint64_t)(shader & 0xFF) << 24) |
+               ((uint64_t)(textura & 0xFFFF) << 8);
+    if (camada == CAMADA_FUNDO)
+        return ((uint64_t)(0x7F - (camada & 0x7F)) << 56) |
+               (zQuantizado << 32) |
+               ((uint64_t)(shader & 0xFF) << 24) |
+               ((uint64_t)(textura & 0xFFFF) << 8);
+    return ((uint64_t)(0x7F - (camada & 0x7F)) << 56) |
+           ((uint64_t)(shader & 0xFF) << 48) |
+           ((uint64_t)(textura & 0xFFFF) << 32) |
+           ((16777215ull - zQuantizado) << 8);
+}
+
+// Passe e shader gravados na chave
+bool chaveTranslucida(uint64_t chave)
+{
+    return (chave >> 63) != 0;
+}
+
+// Translúcidos e fundo opaco guardam a profundidade antes do shader
+bool chavePorProfundidade(uint64_t chave)
+{
+    return chaveTranslucida(chave) || ((chave >> 56) & 0x7F) == (uint64_t)(0x7F - CAMADA_FUNDO);
+}
+
+int shaderDaChave(uint64_t chave)
+{
+    return (int)((chave >> (chavePorProfundidade(chave) ? 24 : 48)) & 0xFF);
+}
+
+// Dados de instância de um sprite (os mesmos atributos que o shader instanciado lê)
+DadosInstancia montarInstancia(const Sprite &sprite)
+{
+    DadosInstancia instancia;
+    instancia.posicao = sprite.posicao;
+    instancia.escala = vec2(sprite.dimensoes.x, sprite.dimensoes.y);
+    instancia.offsetTex = sprite.fatorParallax;
+    instancia.uvAtlas = sprite.uvAtlas;
+    instancia.folhaAnimacao = vec4(sprite.numQuadros, sprite.numAnimacoes, sprite.animacaoAtual, sprite.quadrosPorSegundo);
+    instancia.inicioAnimacao = sprite.inicioAnimacao;
+    instancia.angulo = sprite.angulo;
+    instancia.ancora = sprite.ancora;
+    instancia.tingimento = u8vec4(glm::clamp(sprite.tingimento, 0.0f, 1.0f) * 255.0f + 0.5f);
+    instancia.linhaPaleta = (uint8_t)sprite.linhaPaleta;
+    return instancia;
+}
+
+// Coloca um sprite na fila de desenho do frame (não faz nenhuma chamada OpenGL).
+// RECURSOS escolhe a variante do shader; a fila sempre usa a versão instanciada dela.
+template <uint32_t RECURSOS>
+void enfileirarSprite(const Sprite &sprite, CamadaRender camada)
+{
+    static_assert((RECURSOS & RECURSO_TEXTURA) && !(RECURSOS & (RECURSO_COR_SOLIDA | RECURSO_TINGIMENTO)),
+                  "a fila só desenha sprites texturizados (o tingimento já vem por instância)");
+
+    if (filaRender.comandos.size() >= (size_t)MAX_COMANDOS_RENDER)
+        return;
+
+    DadosInstancia instancia = montarInstancia(sprite);
+
+    // Sem camadas de profundidade tudo vai para o passe com blending, de trás para frente
+    bool translucido = sprite.translucido || !usarCamadasProfundidade;
+    uint32_t shader = RECURSOS | RECURSO_INSTANCIADO | (translucido ? 0u : (uint32_t)RECURSO_RECORTE);
+
+    ComandoRender comando;
+    comando.chave = montarChaveRender(camada, shader, sprite.idTextura, sprite.posicao.z, translucido);
+    comando.indice = (uint32_t)filaRender.instancias.size();
+    filaRender.comandos.push_back(comando);
+    filaRender.instancias.push_back(instancia);
+    filaRender.texturas.push_back(sprite.idTextura);
+    marcarEntradaAtlasUsada(sprite.entradaAtlas);
+}
+
+// Converte uma instância para o rasterizador em software, refazendo na CPU as contas do vertex shader
+// (âncora, rotação, quadro da animação, rolagem e retângulo do atlas) e o estado do passe
+QuadSoftware quadDaInstancia(const DadosInstancia &instancia, GLuint textura, uint32_t recursos, bool translucido)
+{
+    // Do mundo do jogo (LARGURA x ALTURA) para os pixels do alvo
+    vec2 escalaPixels = vec2((float)rasterizador.largura / LARGURA, (float)rasterizador.altura / ALTURA);
+    float seno = sin(radians(instancia.angulo)), cosseno = cos(radians(instancia.angulo));
+    vec2 eixoS = vec2(cosseno, seno) * instancia.escala.x;
+    vec2 eixoT = vec2(-seno, cosseno) * instancia.escala.y;
+
+    QuadSoftware quad;
+    quad.origem = (vec2(instancia.posicao) - eixoS * instancia.ancora.x - eixoT * instancia.ancora.y) * escalaPixels;
+    quad.eixoS = eixoS * escalaPixels;
+    quad.eixoT = eixoT * escalaPixels;
+    quad.profundidade = 0.5f - 0.5f * instancia.posicao.z; // ortho(..., -1, 1): z maior fica mais perto
+    quad.testarProfundidade = usarCamadasProfundidade;
+    u8vec4 tingimento = instancia.tingimento;
+    quad.cor = tingimento.r | (tingimento.g << 8) | (tingimento.b << 16) | ((uint32_t)tingimento.a << 24);
+    quad.suavizacao = 0.0f;
+    if (!(recursos & RECURSO_COR_SOLIDA) && textura == 0)
+        quad.cor &= 0xFF000000; // Textura que não carregou: preto, como a amostragem da textura 0 no OpenGL
+    if ((recursos & RECURSO_COR_SOLIDA) || textura == 0)
+    {
+        quad.textura = -1;
+        quad.modo = QUAD_COR_SOLIDA;
+        quad.texBase = quad.texEscala = vec2(0.0f);
+        return quad;
+    }
+    quad.textura = (int)rasterizador.texturaDaLinha(textura, instancia.linhaPaleta) - 1;
+    quad.modo = translucido ? QUAD_TRANSLUCIDO : QUAD_OPACO;
+
+    // uv = (s, 1 - t), dividido pela folha de animação, rolado e levado ao retângulo do atlas
+    vec2 quadros = vec2(1.0f), quadroAtual = vec2(0.0f), deslocamento = vec2(0.0f);
+    if (recursos & RECURSO_UV_ANIMADO)
+    {
+        vec4 folha = instancia.folhaAnimacao;
+        float quadro = fmodf(floorf(glm::max(constantesFrame.tempo.x - instancia.inicioAnimacao, 0.0f) * folha.w), folha.x);
+        quadros = vec2(folha.x, folha.y);
+        quadroAtual = vec2(quadro, folha.z);
+    }
+    if (recursos & RECURSO_ROLAGEM)
+        deslocamento = instancia.offsetTex * constantesFrame.tempo.z;
+    const TexturaSoftware &texturaSoftware = rasterizador.texturas[quad.textura];
+    vec2 tamanho = vec2(texturaSoftware.largura, texturaSoftware.altura);
+    vec2 retanguloXY = vec2(instancia.uvAtlas.x, instancia.uvAtlas.y), retanguloZW = vec2(instancia.uvAtlas.z, instancia.uvAtlas.w);
+    quad.texBase = (retanguloXY + retanguloZW * ((quadroAtual + vec2(0.0f, 1.0f)) / quadros - deslocamento)) * tamanho;
+    quad.texEscala = vec2(retanguloZW.x / quadros.x, -retanguloZW.y / quadros.y) * tamanho;
+    return quad;
+}
+
+// Ordena os comandos pela chave: radix sort LSD de 8 bits (estável), pulando bytes iguais em todos
+void ordenarComandosRender(vector<ComandoRender> &comandos, vector<ComandoRender> &auxiliar)
+{
+    if (comandos.size() < 2)
+        return;
+    auxiliar.resize(comandos.size());
+    for (int byte = 0; byte < 8; byte++)
+    {
+        int deslocamento = byte * 8;
+        size_t contagem[256] = {};
+        for (size_t i = 0; i < comandos.size(); i++)
+            contagem[(comandos[i].chave >> deslocamento) & 0xFF]++;
+        if (contagem[(comandos[0].chave >> deslocamento) & 0xFF] == comandos.size())
+            continue; // Todos têm o mesmo byte: a passada não mudaria nada
+
+        size_t soma = 0;
+        for (int i = 0; i < 256; i++)
+        {
+            size_t quantidade = contagem[i];
+            contagem[i] = soma;
+            soma += quantidade;
+        }
+        for (size_t i = 0; i < comandos.size(); i++)
+            auxiliar[contagem[(comandos[i].chave >> deslocamento) & 0xFF]++] = comandos[i];
+        comandos.swap(auxiliar);
+    }
+}
+
+// Aponta os atributos de instância do VAO atual para a posição 'base' (em bytes) do buffer vinculado
+void apontarAtributosInstancia(GLintptr base)
+{
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(DadosInstancia), (GLvoid *)(base + offsetof(DadosInstancia, posicao)));
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(DadosInstancia), (GLvoid *)(base + offsetof(DadosInstancia, escala)));
+    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(DadosInstancia), (GLvoid *)(base + offsetof(DadosInstancia, offsetTex)));
+    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(DadosInstancia), (GLvoid *)(base + offsetof(DadosInstancia, uvAtlas)));
+    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(DadosInstancia), (GLvoid *)(base + offsetof(DadosInstancia, folhaAnimacao)));
+    glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, sizeof(DadosInstancia), (GLvoid *)(base + offsetof(DadosInstancia, inicioAnimacao)));
+    glVertexAttribPointer(8, 1, GL_FLOAT, GL_FALSE, sizeof(DadosInstancia), (GLvoid *)(base + offsetof(DadosInstancia, angulo)));
+    glVertexAttribPointer(9, 2, GL_FLOAT, GL_FALSE, sizeof(DadosInstancia), (GLvoid *)(base + offsetof(DadosInstancia, ancora)));
+    glVertexAttribPointer(10, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(DadosInstancia), (GLvoid *)(base + offsetof(DadosInstancia, tingimento)));
+    glVertexAttribPointer(11, 1, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(DadosInstancia), (GLvoid *)(base + offsetof(DadosInstancia, linhaPaleta)));
+}
+
+// Prepara o estado do passe: opacos escrevem profundidade sem blending; translúcidos só testam e misturam.
+// Na visualização de sobreposição os dois passes somam uma cor fixa por fragmento.
+void iniciarPasse(bool translucido)
+{
+    ativarDepthTest(true);
+    definirFuncaoDepth(usarCamadasProfundidade ? GL_LESS : GL_ALWAYS);
+    definirMascaraDepth(!translucido);
+    if (visualizarSobreposicao)
+    {
+        ativarBlend(true);
+        definirFuncaoBlend(GL_ONE, GL_ONE);
+    }
+    else
+    {
+        ativarBlend(translucido);
+        definirFuncaoBlend(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+}
+
+// Lê as consultas alternadas que já têm resultado, da mais antiga para a mais nova, sem esperar a GPU.
+// Retorna true se leu alguma; 'resultado' fica com a mais recente.
+bool lerConsultasProntas(const GLuint consultas[2], bool pendente[2], int atual, GLuint64 &resultado)
+{
+    bool leu = false;
+    int ordem[2] = {atual, 1 - atual}; // Se a consulta 'atual' ainda está pendente, ela é a mais antiga
+    for (int i = 0; i < 2; i++)
+    {
+        int indice = ordem[i];
+        if (!pendente[indice])
+            continue;
+        GLuint disponivel = 0;
+        glGetQueryObjectuiv(consultas[indice], GL_QUERY_RESULT_AVAILABLE, &disponivel);
+        if (!disponivel)
+            break; // A mais nova termina depois desta
+        glGetQueryObjectui64v(consultas[indice], GL_QUERY_RESULT, &resultado);
+        pendente[indice] = false;
+        leu = true;
+    }
+    return leu;
+}
+
+// Lê o resultado da occlusion query de um frame anterior, se já estiver pronto (nunca espera a GPU)
+void lerContagemFragmentos()
+{
+    GLuint64 amostras = 0;
+    if (!lerConsultasProntas(consultasFragmentos, consultaPendente, consultaAtual, amostras))
+        return;
+    double amostrasTela = (double)alvoRender.largura * alvoRender.altura * glm::max(alvoRender.amostras, 1);
+    sobreposicaoMedia = amostrasTela > 0.0 ? amostras / amostrasTela : 0.0;
+}
+
+// Ordena a fila do frame e envia tudo à GPU: um draw instanciado por sequência de mesmo shader e textura
+void submeterFilaRender()
+{
+    FilaRender &fila = filaRender;
+    size_t total = fila.comandos.size();
+    if (total == 0)
+        return;
+
+    ordenarComandosRender(fila.comandos, fila.auxiliar);
+
+    // Modo software: os comandos viram quads do rasterizador na mesma ordem (mesmos passes e profundidade)
+    if (renderSoftware)
+    {
+        for (size_t i = 0; i < total; i++)
+        {
+            const ComandoRender &comando = fila.comandos[i];
+            rasterizador.adicionar(quadDaInstancia(fila.instancias[comando.indice], fila.texturas[comando.indice],
+                                                   (uint32_t)shaderDaChave(comando.chave), chaveTranslucida(comando.chave)));
+        }
+        contadorSpritesDesenhados += (int)total;
+        fila.comandos.clear();
+        fila.instancias.clear();
+        fila.texturas.clear();
+        return;
+    }
+
+    // Escreve as instâncias, já na ordem de submissão, direto na região do frame do buffer de streaming
+    GLintptr offsetInstancias;
+    DadosInstancia *destino = (DadosInstancia *)bufferInstancias.reservar(total * sizeof(DadosInstancia), offsetInstancias);
+    if (!destino)
+    {
+        fila.comandos.clear();
+        fila.instancias.clear();
+        fila.texturas.clear();
+        return;
+    }
+    for (size_t i = 0; i < total; i++)
+        destino[i] = fila.instancias[fila.comandos[i].indice];
+    bufferInstancias.concluirEscrita();
+
+    // Conta as amostras que passam no depth test (só é lida num frame seguinte)
+    bool contar = !consultaPendente[consultaAtual];
+    if (contar)
+        glBeginQuery(GL_SAMPLES_PASSED, consultasFragmentos[consultaAtual]);
+
+    vincularVAO(VAOInstancias);
+    size_t inicio = 0;
+    while (inicio < total)
+    {
+        uint64_t chave = fila.comandos[inicio].chave;
+        bool translucido = chaveTranslucida(chave);
+        int shader = shaderDaChave(chave);
+        GLuint textura = fila.texturas[fila.comandos[inicio].indice];
+
+        // Junta os comandos seguintes que usam o mesmo estado (sem instancing, um draw por comando)
+        size_t fim = inicio + 1;
+        while (usarInstancing && fim < total &&
+               chaveTranslucida(fila.comandos[fim].chave) == translucido &&
+               shaderDaChave(fila.comandos[fim].chave) == shader &&
+               fila.texturas[fila.comandos[fim].indice] == textura)
+            fim++;
+
+        iniciarPasse(translucido);
+        GLuint paleta = paletaDaTextura(textura);
+        uint32_t variante = (uint32_t)shader | (paleta ? (uint32_t)RECURSO_PALETA : 0u) |
+                            (visualizarSobreposicao ? (uint32_t)RECURSO_SOBREPOSICAO : 0u);
+        obterVarianteShader(variante).programa.usar();
+        vincularTextura(0, textura);
+        if (paleta)
+            vincularTextura(UNIDADE_PALETA, paleta);
+        apontarAtributosInstancia(offsetInstancias + inicio * sizeof(DadosInstancia));
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)(fim - inicio));
+        contadorDrawCalls++;
+        inicio = fim;
+    }
+    contadorSpritesDesenhados += (int)total;
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (contar)
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        consultaPendente[consultaAtual] = true;
+        consultaAtual = 1 - consultaAtual;
+    }
+
+    // Volta ao estado padrão (o menu desenha fora da fila e o glClear precisa da escrita de profundidade)
+    definirMascaraDepth(true);
+    ativarBlend(true);
+    definirFuncaoBlend(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    fila.comandos.clear();
+    fila.instancias.clear();
+    fila.texturas.clear();
+}
+
+// Hash FNV-1a de 64 bits (identifica o conteúdo de arquivos nos caches em disco)
+uint64_t hashFNV1a(const void *dados, size_t tamanho, uint64_t hash)
+{
+    const unsigned char *bytes = (const unsigned char *)dados;
+    for (size_t i = 0; i < tamanho; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Cabeçalho do cache do atlas SDF; o cache só vale para a mesma fonte e os mesmos parâmetros
+struct CabecalhoCacheSDF
+{
+    char magica[4];      // "SDF1"
+    uint64_t hashFonte;  // Hash do arquivo .ttf
+    float tamanho;       // TAMANHO_FONTE_ATLAS
+    int margem;          // MARGEM_SDF
+    int largura, altura; // Dimensões do atlas
+};
+
+// Lê o atlas SDF do cache em disco (false se não existir ou for de outra fonte/parâmetros)
+bool lerCacheFonteSDF(uint64_t hashFonte, vector<unsigned char> &bitmap)
+{
+    ifstream arquivo(CAMINHO_CACHE_FONTE_SDF, ios::binary);
+    if (!arquivo)
+        return false;
+    CabecalhoCacheSDF cabecalho;
+    if (!arquivo.read((char *)&cabecalho, sizeof(cabecalho)) || memcmp(cabecalho.magica, "SDF1", 4) != 0 ||
+        cabecalho.hashFonte != hashFonte || cabecalho.tamanho != TAMANHO_FONTE_ATLAS || cabecalho.margem != MARGEM_SDF ||
+        cabecalho.largura <= 0 || cabecalho.altura <= 0 || cabecalho.altura > ALTURA_MAXIMA_ATLAS_FONTE)
+        return false;
+    bitmap.resize((size_t)cabecalho.largura * cabecalho.altura);
+    if (!arquivo.read((char *)dadosCaracteres, sizeof(dadosCaracteres)) ||
+        !arquivo.read((char *)bitmap.data(), bitmap.size()))
+        return false;
+    larguraAtlasFonte = cabecalho.largura;
+    alturaAtlasFonte = cabecalho.altura;
+    return true;
+}
+
+// Grava o atlas SDF para as próximas execuções (falhar aqui só custa gerar de novo)
+void salvarCacheFonteSDF(uint64_t hashFonte, const vector<unsigned char> &bitmap)
+{
+    ofstream arquivo(CAMINHO_CACHE_FONTE_SDF, ios::binary);
+    if (!arquivo)
+    {
+        cerr << "Falha ao gravar o cache da fonte em " << CAMINHO_CACHE_FONTE_SDF << endl;
+        return;
+    }
+    // Zera tudo antes (inclusive o preenchimento depois de 'magica'), para não gravar lixo da pilha no arquivo
+    CabecalhoCacheSDF cabecalho{};
+    memcpy(cabecalho.magica, "SDF1", 4);
+    cabecalho.hashFonte = hashFonte;
+    cabecalho.tamanho = TAMANHO_FONTE_ATLAS;
+    cabecalho.margem = MARGEM_SDF;
+    cabecalho.largura = larguraAtlasFonte;
+    cabecalho.altura = alturaAtlasFonte;
+    arquivo.write((const char *)&cabecalho, sizeof(cabecalho));
+    arquivo.write((const char *)dadosCaracteres, sizeof(dadosCaracteres));
+    arquivo.write((const char *)bitmap.data(), bitmap.size());
+}
+
+// Gera o campo de distância de cada caractere com stb_truetype e empacota tudo em um atlas.
+// O atlas começa com ALTURA_INICIAL_ATLAS_FONTE linhas e dobra se os caracteres não couberem.
+bool gerarAtlasFonteSDF(const vector<unsigned char> &arquivoFonte, vector<unsigned char> &bitmap)
+{
+    stbtt_fontinfo fonte;
+    if (!stbtt_InitFont(&fonte, arquivoFonte.data(), stbtt_GetFontOffsetForIndex(arquivoFonte.data(), 0)))
+        return false;
+    float escala = stbtt_ScaleForPixelHeight(&fonte, TAMANHO_FONTE_ATLAS);
+
+    // Campos de distância de todos os caracteres (a borda do glifo fica no valor VALOR_BORDA_SDF)
+    struct GlifoSDF
+    {
+        unsigned char *pixels;
+        int largura, altura, xoff, yoff;
+    };
+    GlifoSDF glifos[NUM_CARACTERES];
+    for (int i = 0; i < NUM_CARACTERES; i++)
+    {
+        GlifoSDF &glifo = glifos[i];
+        glifo.pixels = stbtt_GetCodepointSDF(&fonte, escala, PRIMEIRO_CARACTERE + i, MARGEM_SDF, VALOR_BORDA_SDF,
+                                             (float)VALOR_BORDA_SDF / MARGEM_SDF, &glifo.largura, &glifo.altura, &glifo.xoff, &glifo.yoff);
+        if (!glifo.pixels) // Espaço e caracteres sem contorno
+            glifo.largura = glifo.altura = glifo.xoff = glifo.yoff = 0;
+        int avanco, apoioEsquerdo;
+        stbtt_GetCodepointHMetrics(&fonte, PRIMEIRO_CARACTERE + i, &avanco, &apoioEsquerdo);
+        stbtt_bakedchar &dados = dadosCaracteres[i];
+        dados.xoff = (float)glifo.xoff;
+        dados.yoff = (float)glifo.yoff;
+        dados.xadvance = avanco * escala;
+    }
+
+    // Empacota com 1 pixel de separação (a filtragem linear não mistura glifos vizinhos)
+    bool coube = false;
+    for (alturaAtlasFonte = ALTURA_INICIAL_ATLAS_FONTE; alturaAtlasFonte <= ALTURA_MAXIMA_ATLAS_FONTE; alturaAtlasFonte *= 2)
+    {
+        larguraAtlasFonte = LARGURA_ATLAS_FONTE;
+        EmpacotadorSkyline empacotador;
+        empacotador.iniciar(larguraAtlasFonte, alturaAtlasFonte);
+        coube = true;
+        for (int i = 0; i < NUM_CARACTERES && coube; i++)
+        {
+            int x = 0, y = 0;
+            if (glifos[i].pixels)
+                coube = empacotador.inserir(glifos[i].largura + 1, glifos[i].altura + 1, x, y);
+            dadosCaracteres[i].x0 = (unsigned short)x;
+            dadosCaracteres[i].y0 = (unsigned short)y;
+            dadosCaracteres[i].x1 = (unsigned short)(x + glifos[i].largura);
+            dadosCaracteres[i].y1 = (unsigned short)(y + glifos[i].altura);
+        }
+        if (coube)
+            break;
+    }
+    if (coube)
+    {
+        bitmap.assign((size_t)larguraAtlasFonte * alturaAtlasFonte, 0);
+        for (int i = 0; i < NUM_CARACTERES; i++)
+        {
+            for (int linha = 0; linha < glifos[i].altura; linha++)
+                memcpy(&bitmap[(size_t)(dadosCaracteres[i].y0 + linha) * larguraAtlasFonte + dadosCaracteres[i].x0],
+                       glifos[i].pixels + linha * glifos[i].largura, glifos[i].largura);
+        }
+    }
+    for (int i = 0; i < NUM_CARACTERES; i++)
+        stbtt_FreeSDF(glifos[i].pixels, nullptr);
+    return coube;
+}
+
+// Carrega a fonte TrueType do jogo e monta o atlas SDF dos caracteres ASCII imprimíveis
+// (do cache em disco quando possível). Um atlas serve para qualquer tamanho de texto.
+// Também cria o VAO e o buffer de streaming do texto.
+bool carregarFonte(const string &caminho)
+{
+    vector<unsigned char> arquivoFonte;
+    ifstream arquivo(caminho, ios::binary);
+    if (arquivo)
+        arquivoFonte.assign(istreambuf_iterator<char>(arquivo), istreambuf_iterator<char>());
+    if (arquivoFonte.empty())
+    {
+        cerr << "Falha ao carregar a fonte " << caminho << ": o HUD continua no título da janela" << endl;
+        return false;
+    }
+
+    vector<unsigned char> bitmap;
+    uint64_t hashFonte = hashFNV1a(arquivoFonte.data(), arquivoFonte.size());
+    bool doCache = lerCacheFonteSDF(hashFonte, bitmap);
+    if (!doCache)
+    {
+        if (!gerarAtlasFonteSDF(arquivoFonte, bitmap))
+        {
+            cerr << "Falha ao gerar o atlas SDF da fonte " << caminho << endl;
+            return false;
+        }
+        salvarCacheFonteSDF(hashFonte, bitmap);
+    }
+
+    printf("Fonte: %s (atlas SDF %dx%d, %s)\n", caminho.c_str(), larguraAtlasFonte, alturaAtlasFonte,
+           doCache ? "do cache" : "gerado agora");
+
+    // Modo software: o atlas fica na memória do rasterizador (o texto não usa VAO nem programa)
+    if (renderSoftware)
+    {
+        texturaFonte = rasterizador.criarTextura(bitmap.data(), larguraAtlasFonte, alturaAtlasFonte, 1, false);
+        return true;
+    }
+
+    // Atlas de um canal (distância), com filtro linear para o contorno sair suave
+    texturaFonte = criarTextura2D(bitmap.data(), larguraAtlasFonte, alturaAtlasFonte, 1, GL_CLAMP_TO_EDGE, GL_LINEAR, SEM_MIPMAPS);
+
+    // Vértices do texto: reescritos a cada frame no buffer de streaming
+    bufferTexto.criar(GL_ARRAY_BUFFER, MAX_CARACTERES_TEXTO * 6 * sizeof(VerticeTexto));
+    glGenVertexArrays(1, &VAOTexto);
+    vincularVAO(VAOTexto);
+    glBindBuffer(GL_ARRAY_BUFFER, bufferTexto.id);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(VerticeTexto), (GLvoid *)offsetof(VerticeTexto, posicao));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(VerticeTexto), (GLvoid *)offsetof(VerticeTexto, uv));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(VerticeTexto), (GLvoid *)offsetof(VerticeTexto, cor));
+    glEnableVertexAttribArray(2);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    vincularVAO(0);
+
+    programaTexto = configurarShader(codigoFonteVertexTexto, codigoFonteFragmentTexto);
+    programaTexto.definir(programaTexto.uniforme<int>("tex_buff"), 0);
+    return true;
+}
+
+// Monta os quads de um texto no tamanho do atlas, com a linha de base da primeira linha em y = 0
+// (y para cima, como o mundo do jogo). Caracteres fora do atlas viram '?'. Sem arredondar para pixels:
+// o texto é escalado depois, e o SDF não precisa de alinhamento.
+void prepararTexto(const string &texto, TextoPreparado &saida)
+{
+    saida.vertices.clear();
+    saida.largura = 0.0f;
+    float x = 0.0f, y = 0.0f; // Métricas do stb_truetype têm y para baixo
+    for (char c : texto)
+    {
+        if (c == '\n')
+        {
+            x = 0.0f;
+            y += TAMANHO_FONTE_ATLAS * ESPACAMENTO_LINHAS;
+            continue;
+        }
+        int indice = (unsigned char)c - PRIMEIRO_CARACTERE;
+        if (indice < 0 || indice >= NUM_CARACTERES)
+            indice = '?' - PRIMEIRO_CARACTERE;
+
+        const stbtt_bakedchar &dados = dadosCaracteres[indice];
+        stbtt_aligned_quad q;
+        q.x0 = x + dados.xoff;
+        q.y0 = y + dados.yoff;
+        q.x1 = q.x0 + (dados.x1 - dados.x0);
+        q.y1 = q.y0 + (dados.y1 - dados.y0);
+        q.s0 = dados.x0 / (float)larguraAtlasFonte;
+        q.t0 = dados.y0 / (float)alturaAtlasFonte;
+        q.s1 = dados.x1 / (float)larguraAtlasFonte;
+        q.t1 = dados.y1 / (float)alturaAtlasFonte;
+        x += dados.xadvance;
+        saida.largura = glm::max(saida.largura, x);
+        if (q.x0 == q.x1) // Espaço: só avança
+            continue;
+
+        VerticeTexto v00 = {vec2(q.x0, -q.y0), vec2(q.s0, q.t0), vec4(1.0f)};
+        VerticeTexto v10 = {vec2(q.x1, -q.y0), vec2(q.s1, q.t0), vec4(1.0f)};
+        VerticeTexto v01 = {vec2(q.x0, -q.y1), vec2(q.s0, q.t1), vec4(1.0f)};
+        VerticeTexto v11 = {vec2(q.x1, -q.y1), vec2(q.s1, q.t1), vec4(1.0f)};
+        VerticeTexto quad[6] = {v00, v01, v11, v00, v11, v10};
+        saida.vertices.insert(saida.vertices.end(), quad, quad + 6);
+    }
+}
+
+// Copia um texto preparado para os vértices do frame, na posição, tamanho e cor pedidos
+void acrescentarTexto(const TextoPreparado &texto, vec2 posicao, float tamanho, vec4 cor)
+{
+    if (verticesTexto.size() + texto.vertices.size() > (size_t)MAX_CARACTERES_TEXTO * 6)
+        return;
+    float escala = tamanho / TAMANHO_FONTE_ATLAS;
+    for (const VerticeTexto &v : texto.vertices)
+        verticesTexto.push_back({posicao + v.posicao * escala, v.uv, cor});
+}
+
+// Texto que muda a cada frame (números do HUD): montado na hora, sem passar pelo cache.
+// 'posicao' é o início da linha de base.
+void escreverTexto(const string &texto, vec2 posicao, float tamanho, vec4 cor)
+{
+    if (!fonteCarregada)
+        return;
+    static TextoPreparado temporario; // Reaproveita a memória entre chamadas
+    prepararTexto(texto, temporario);
+    acrescentarTexto(temporario, posicao, tamanho, cor);
+}
+
+// Texto fixo (rótulos): montado uma vez e guardado no cache. Centralizado, 'posicao' é o centro do texto.
+void escreverTextoFixo(const string &texto, vec2 posicao, float tamanho, vec4 cor, bool centralizar)
+{
+    if (!fonteCarregada)
+        return;
+    auto encontrado = cacheTextos.find(texto);
+    if (encontrado == cacheTextos.end())
+    {
+        encontrado = cacheTextos.emplace(texto, TextoPreparado()).first;
+        prepararTexto(texto, encontrado->second);
+    }
+    const TextoPreparado &preparado = encontrado->second;
+    if (centralizar)
+    {
+        float escala = tamanho / TAMANHO_FONTE_ATLAS;
+        posicao -= vec2(preparado.largura * escala * 0.5f, tamanho * ALTURA_MAIUSCULAS * 0.5f);
+    }
+    acrescentarTexto(preparado, posicao, tamanho, cor);
+}
+
+// Envia todo o texto do frame em um único draw, por cima do resto (sem depth test)
+void desenharTextos()
+{
+    if (verticesTexto.empty())
+        return;
+
+    // Modo software: cada caractere vira um quad (vértices v00, v01, v11, v00, v11, v10, ver prepararTexto)
+    if (renderSoftware)
+    {
+        vec2 escalaPixels = vec2((float)rasterizador.largura / LARGURA, (float)rasterizador.altura / ALTURA);
+        vec2 tamanhoAtlas = vec2(larguraAtlasFonte, alturaAtlasFonte);
+        for (size_t i = 0; i + 6 <= verticesTexto.size(); i += 6)
+        {
+            const VerticeTexto &v00 = verticesTexto[i], &v01 = verticesTexto[i + 1], &v10 = verticesTexto[i + 5];
+            QuadSoftware quad;
+            quad.origem = v00.posicao * escalaPixels;
+            quad.eixoS = (v10.posicao - v00.posicao) * escalaPixels;
+            quad.eixoT = (v01.posicao - v00.posicao) * escalaPixels;
+            quad.texBase = v00.uv * tamanhoAtlas;
+            quad.texEscala = vec2(v10.uv.x - v00.uv.x, v01.uv.y - v00.uv.y) * tamanhoAtlas;
+            quad.profundidade = 0.0f;
+            quad.testarProfundidade = false;
+            u8vec4 cor = u8vec4(glm::clamp(v00.cor, 0.0f, 1.0f) * 255.0f + 0.5f);
+            quad.cor = cor.r | (cor.g << 8) | (cor.b << 16) | ((uint32_t)cor.a << 24);
+            quad.textura = (int)texturaFonte - 1;
+            quad.modo = QUAD_TEXTO_SDF;
+            // No lugar do fwidth: a distância muda (VALOR_BORDA_SDF / MARGEM_SDF) / 255 por texel do atlas
+            float texelsPorPixel = fabsf(quad.texEscala.x) / glm::max(fabsf(quad.eixoS.x), 1.0e-4f);
+            quad.suavizacao = glm::max(0.7f * VALOR_BORDA_SDF / MARGEM_SDF / 255.0f * texelsPorPixel, 1.0e-4f);
+            rasterizador.adicionar(quad);
+        }
+        contadorDrawCalls++;
+        verticesTexto.clear();
+        return;
+    }
+
+    GLintptr offset;
+    VerticeTexto *destino = (VerticeTexto *)bufferTexto.reservar(verticesTexto.size() * sizeof(VerticeTexto), offset);
+    if (destino)
+    {
+        memcpy(destino, verticesTexto.data(), verticesTexto.size() * sizeof(VerticeTexto));
+        bufferTexto.concluirEscrita();
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        ativarDepthTest(false);
+        ativarBlend(true);
+        definirFuncaoBlend(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        programaTexto.usar();
+        vincularTextura(0, texturaFonte);
+        vincularVAO(VAOTexto);
+        // As reservas são alinhadas a 64 bytes, múltiplo do tamanho do vértice
+        glDrawArrays(GL_TRIANGLES, (GLint)(offset / sizeof(VerticeTexto)), (GLsizei)verticesTexto.size());
+        contadorDrawCalls++;
+        ativarDepthTest(true);
+    }
+    verticesTexto.clear();
+}
+
+// Verifica colisão entre dois sprites usando bounding boxes
+bool verificarColisao(const Sprite &a, const Sprite &b)
+{
+    // Calcula os limites do sprite A
+    float aEsquerda = a.posicao.x - a.dimensoes.x * 0.2f;
+    float aDireita = a.posicao.x + a.dimensoes.x * 0.2f;
+    float aTopo = a.posicao.y + a.dimensoes.y * 0.2f;
+    float aBase = a.posicao.y - a.dimensoes.y * 0.2f;
+
+    // Calcula os limites do sprite B
+    float bEsquerda = b.posicao.x - b.dimensoes.x * 0.2f;
+    float bDireita = b.posicao.x + b.dimensoes.x * 0.2f;
+    float bTopo = b.posicao.y + b.dimensoes.y * 0.2f;
+    float bBase = b.posicao.y - b.dimensoes.y * 0.2f;
+
+    // Verifica sobreposição nas duas dimensões
+    return (aDireita > bEsquerda && aEsquerda < bDireita && aTopo > bBase && aBase < bTopo);
+}
+
+// Verifica se o mouse está sobre um botão
+bool mouseSobreBotao(vec2 posicaoMouse, Botao botao)
+{
+    return (posicaoMouse.x > botao.posicao.x - botao.tamanho.x / 2 &&
+            posicaoMouse.x < botao.posicao.x + botao.tamanho.x / 2 &&
+            posicaoMouse.y > botao.posicao.y - botao.tamanho.y / 2 &&
+            posicaoMouse.y < botao.posicao.y + botao.tamanho.y / 2);
+}
+
+// Cria uma vez os sprites dos botões (todos compartilham o mesmo VAO unitário)
+void construirMenu()
+{
+    GLuint VAOBotao = configurarSprite();
+    for (int i = 0; i < NUM_BOTOES; i++)
+    {
+        Sprite &spriteBotao = camadaMenu.botoes[i];
+        spriteBotao.VAO = VAOBotao;
+        spriteBotao.posicao = vec3(botoes[i].posicao.x, botoes[i].posicao.y, 0);
+        spriteBotao.dimensoes = vec3(botoes[i].tamanho.x, botoes[i].tamanho.y, 1);
+        spriteBotao.idTextura = 0;
+    }
+}
+
+// Renderiza o menu com os botões (geometria e destaque já prontos na camada do menu)
+void renderizarMenu()
+{
+    // Limpa a tela com cor escura
+    limparTela(vec4(0.1f, 0.1f, 0.1f, 1.0f), GL_COLOR_BUFFER_BIT);
+
+    // Desenha cada botão
+    for (int i = 0; i < NUM_BOTOES; i++)
+    {
+        // Define cor do botão normal e hover
+        vec3 corBotao = botoes[i].cor;
+        if (i == camadaMenu.botaoSobMouse)
+        {
+            if (i == 0)                       // Botão PLAY
+                corBotao = COR_HOVER_INICIAR; // Vermelho claro
+            else                              // Botão SAIR
+                corBotao = COR_HOVER_SAIR;    // Roxo claro
+        }
+
+        // Desenha com a variante de cor sólida do shader
+        drawSprite<SPRITE_COR_SOLIDA>(camadaMenu.botoes[i], vec4(corBotao, 1.0f));
+
+        // Rótulo (montado uma vez; vai no draw único do texto no fim do frame)
+        escreverTextoFixo(botoes[i].texto, botoes[i].posicao, TAMANHO_TEXTO_BOTAO, vec4(0.05f, 0.05f, 0.1f, 1.0f), true);
+    }
+}
+
+// Converte a posição do cursor (coordenadas da janela, y para baixo) para o mundo do jogo e
+// recalcula o botão destacado; só pede um novo desenho quando o destaque muda
+void atualizarBotaoSobMouse(GLFWwindow *janela, double xpos, double ypos)
+{
+    int larguraJanela, alturaJanela;
+    glfwGetWindowSize(janela, &larguraJanela, &alturaJanela);
+    if (larguraJanela <= 0 || alturaJanela <= 0) // Janela minimizada
+        return;
+    vec2 posicaoMouse(xpos * LARGURA / larguraJanela, ALTURA - ypos * ALTURA / alturaJanela);
+
+    int sobMouse = -1;
+    for (int i = 0; i < NUM_BOTOES; i++)
+    {
+        if (mouseSobreBotao(posicaoMouse, botoes[i]))
+            sobMouse = i;
+    }
+    if (sobMouse != camadaMenu.botaoSobMouse)
+    {
+        camadaMenu.botaoSobMouse = sobMouse;
+        telaAlterada = true;
+    }
+}
+
+// Callback de movimento do cursor: atualiza o destaque dos botões do menu
+void cursorCallbackMenu(GLFWwindow *janela, double xpos, double ypos)
+{
+    if (estadoJogo == MENU)
+        atualizarBotaoSobMouse(janela, xpos, ypos);
+}
+
+// Callback de "refresh" da janela (exposta ou redimensionada): a tela parada precisa ser redesenhada
+void redesenharCallback(GLFWwindow *janela)
+{
+    telaAlterada = true;
+}
+
+// Troca o estado do jogo e pede um novo desenho. Ao entrar no menu lê o cursor uma vez para
+// o destaque já começar certo (depois ele só muda pelo callback do cursor).
+void mudarEstadoJogo(EstadoJogo novoEstado)
+{
+    estadoJogo = novoEstado;
+    telaAlterada = true;
+    if (novoEstado == JOGANDO)
+    {
+        distanciaInicioPartida = distanciaEstrada; // Zera a pontuação
+        jogador.angulo = 0.0f;
+        jogador.tingimento = vec4(1.0f);
+    }
+    else if (novoEstado == MENU)
+    {
+        double xpos, ypos;
+        glfwGetCursorPos(janela, &xpos, &ypos);
+        atualizarBotaoSobMouse(janela, xpos, ypos);
+    }
+    else if (novoEstado == FIM_DE_JOGO)
+    {
+        instanteFimDeJogo = relogioJogo();
+        jogador.tingimento = COR_BATIDA;
+    }
+}
+
+// Começa uma partida a partir do menu (Enter, botão Iniciar ou o modo headless)
+void iniciarPartida()
+{
+    mudarEstadoJogo(JOGANDO);
+    jogador.posicao = vec3(300, 100, PROFUNDIDADE_JOGADOR); // Reposiciona jogador
+    iniciarAnimacao(jogador, 0);
+    // Reseta posição dos inimigos
+    for (int j = 0; j < MAX_INIMIGOS; j++)
+    {
+        inimigos[j].posicao = vec3(-100.0f, -100.0f, PROFUNDIDADE_INIMIGOS);
+    }
+}
+
+// Callback para clique do mouse no menu
+void mouseCallbackMenu(GLFWwindow *janela, int botao, int acao, int mods)
+{
+    if (estadoJogo == MENU && botao == GLFW_MOUSE_BUTTON_LEFT && acao == GLFW_PRESS)
+    {
+        // O botão sob o cursor já é conhecido pelo callback de movimento
+        if (camadaMenu.botaoSobMouse == 0) // Botão Iniciar
+        {
+            iniciarPartida(); // Muda para estado de jogo
+        }
+        else if (camadaMenu.botaoSobMouse == 1) // Botão Sair
+        {
+            glfwSetWindowShouldClose(janela, GL_TRUE); // Fecha o jogo
+        }
+    }
+}
+
+// Callback para teclado (usado no menu e no jogo)
+void tecladoCallbackMenu(GLFWwindow *janela, int tecla, int scancode, int acao, int modo)
+{
+    // Tecla ESC - volta para o menu ou sai
+    if (tecla == GLFW_KEY_ESCAPE && acao == GLFW_PRESS)
+    {
+        if (estadoJogo == JOGANDO)
+        {
+            mudarEstadoJogo(MENU); // Volta ao menu
+        }
+        else
+        {
+            glfwSetWindowShouldClose(janela, GL_TRUE); // Sai do jogo
+        }
+    }
+
+    // Tecla I - alterna o agrupamento dos comandos em draws instanciados
+    if (tecla == GLFW_KEY_I && acao == GLFW_PRESS)
+    {
+        usarInstancing = !usarInstancing;
+    }
+
+    // Tecla P - alterna entre camadas por profundidade (opacos com early-z) e blending de tudo
+    if (tecla == GLFW_KEY_P && acao == GLFW_PRESS)
+    {
+        usarCamadasProfundidade = !usarCamadasProfundidade;
+    }
+
+    // Tecla O - liga a visualização de sobreposição
+    if (tecla == GLFW_KEY_O && acao == GLFW_PRESS)
+    {
+        visualizarSobreposicao = !visualizarSobreposicao;
+    }
+
+    // Tecla Q - escolhe o próximo nível de qualidade à mão (desliga o governador); G religa o governador
+    if (tecla == GLFW_KEY_Q && acao == GLFW_PRESS)
+    {
+        governador.automatico = false;
+        aplicarNivelQualidade((governador.nivel + 1) % NUM_NIVEIS_QUALIDADE);
+    }
+    if (tecla == GLFW_KEY_G && acao == GLFW_PRESS)
+    {
+        governador.automatico = !governador.automatico;
+    }
+
+    // Tecla V - próximo modo de ritmo dos frames (vsync, livre, limitado, baixa latência)
+    if (tecla == GLFW_KEY_V && acao == GLFW_PRESS)
+    {
+        agendador.definirModo((ModoRitmo)((agendador.modo + 1) % NUM_MODOS_RITMO));
+    }
+
+    // Tecla C - grava o próximo frame em PNG; K começa ou termina um clipe (um PNG por frame)
+    if (tecla == GLFW_KEY_C && acao == GLFW_PRESS)
+    {
+        pedidoCapturaTela = true;
+    }
+    if (tecla == GLFW_KEY_K && acao == GLFW_PRESS)
+    {
+        alternarClipe();
+    }
+
+    // Atualiza array de teclas pressionadas
+    if (acao == GLFW_PRESS)
+    {
+        teclas[tecla] = true;
+        telaAlterada = true; // As teclas de alternância mudam a imagem da tela parada
+        // Enter no menu inicia o jogo
+        if (estadoJogo == MENU && tecla == GLFW_KEY_ENTER)
+        {
+            iniciarPartida();
+        }
+    }
+    else if (acao == GLFW_RELEASE)
+    {
+        teclas[tecla] = false;
+    }
+}
+
+// Cabeçalho do cache de programas: o arquivo inteiro vale só para o driver que o gravou
+struct CabecalhoCacheProgramas
+{
+    char magica[4];      // "PRG1"
+    uint64_t hashDriver; // hashDriverGL() de quem gravou
+};
+
+// Cada entrada do cache de programas, seguida de 'tamanho' bytes do binário
+struct EntradaCacheProgramas
+{
+    uint64_t hashFontes; // Hash dos fontes do vertex e do fragment shader
+    uint32_t formato;    // Formato do binário (o driver pode ter mais de um)
+    uint32_t tamanho;
+};
+
+// Identifica o driver: binários de outro fabricante, placa ou versão não servem
+uint64_t hashDriverGL()
+{
+    const GLenum NOMES[] = {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION};
+    uint64_t hash = hashFNV1a("", 0);
+    for (GLenum nome : NOMES)
+    {
+        const char *texto = (const char *)glGetString(nome);
+        if (texto)
+            hash = hashFNV1a(texto, strlen(texto) + 1, hash);
+    }
+    return hash;
+}
+
+// Lê os binários gravados por este driver (um arquivo de outro driver ou corrompido é ignorado e será regravado)
+void lerCacheProgramas()
+{
+    cacheProgramasLido = true;
+    ifstream arquivo(CAMINHO_CACHE_PROGRAMAS, ios::binary);
+    if (!arquivo)
+        return;
+    CabecalhoCacheProgramas cabecalho;
+    if (!arquivo.read((char *)&cabecalho, sizeof(cabecalho)) || memcmp(cabecalho.magica, "PRG1", 4) != 0 ||
+        cabecalho.hashDriver != hashDriverGL())
+        return;
+    cacheProgramasDoDriver = true;
+    EntradaCacheProgramas entrada;
+    while (arquivo.read((char *)&entrada, sizeof(entrada)))
+    {
+        BinarioPrograma binario;
+        binario.formato = entrada.formato;
+        if (entrada.tamanho > TAMANHO_MAXIMO_BINARIO)
+        {
+            cacheProgramasDoDriver = false;
+            break;
+        }
+        binario.dados.resize(entrada.tamanho);
+        if (!arquivo.read(binario.dados.data(), entrada.tamanho))
+        {
+            cacheProgramasDoDriver = false; // Gravação interrompida: o arquivo é refeito na próxima entrada
+            break;
+        }
+        cacheProgramas[entrada.hashFontes] = binario; // Uma entrada mais nova do mesmo programa substitui a antiga
+    }
+}
+
+// Guarda o binário do programa recém-vinculado: acrescenta ao fim do arquivo ou, se ele não servir, regrava
+// o arquivo com todas as entradas conhecidas. Falhar aqui só custa compilar de novo na próxima execução.
+void gravarBinarioPrograma(uint64_t hashFontes, GLuint programa)
+{
+    GLint tamanho = 0;
+    glGetProgramiv(programa, GL_PROGRAM_BINARY_LENGTH, &tamanho);
+    if (tamanho <= 0)
+        return;
+    BinarioPrograma &binario = cacheProgramas[hashFontes];
+    binario.dados.resize(tamanho);
+    GLsizei lidos = 0;
+    pglGetProgramBinary(programa, tamanho, &lidos, &binario.formato, binario.dados.data());
+    binario.dados.resize(lidos);
+
+    ofstream arquivo(CAMINHO_CACHE_PROGRAMAS, ios::binary | (cacheProgramasDoDriver ? ios::app : ios::trunc));
+    if (!arquivo)
+    {
+        cerr << "Falha ao gravar o cache de programas em " << CAMINHO_CACHE_PROGRAMAS << endl;
+        return;
+    }
+    if (!cacheProgramasDoDriver)
+    {
+        CabecalhoCacheProgramas cabecalho{}; // Zerado: o preenchimento depois de 'magica' também vai para o arquivo
+        memcpy(cabecalho.magica, "PRG1", 4);
+        cabecalho.hashDriver = hashDriverGL();
+        arquivo.write((const char *)&cabecalho, sizeof(cabecalho));
+    }
+    for (auto &par : cacheProgramas)
+    {
+        if (cacheProgramasDoDriver && par.first != hashFontes)
+            continue;
+        EntradaCacheProgramas entrada = {par.first, par.second.formato, (uint32_t)par.second.dados.size()};
+        arquivo.write((const char *)&entrada, sizeof(entrada));
+        arquivo.write(par.second.dados.data(), par.second.dados.size());
+    }
+    cacheProgramasDoDriver = (bool)arquivo;
+}
+
+// Recria o programa a partir do binário no cache (0 se não houver ou se o driver o recusar)
+GLuint carregarBinarioPrograma(uint64_t hashFontes)
+{
+    auto encontrado = cacheProgramas.find(hashFontes);
+    if (encontrado == cacheProgramas.end())
+        return 0;
+    GLuint programa = glCreateProgram();
+    pglProgramBinary(programa, encontrado->second.formato, encontrado->second.dados.data(), (GLsizei)encontrado->second.dados.size());
+    GLint sucesso;
+    glGetProgramiv(programa, GL_LINK_STATUS, &sucesso);
+    if (!sucesso) // Driver atualizado sem mudar a versão, por exemplo: compila de novo e troca a entrada
+    {
+        glDeleteProgram(programa);
+        return 0;
+    }
+    return programa;
+}
+
+// Compila um estágio do shader; em caso de erro mostra o log do driver e retorna 0
+GLuint compilarShader(GLenum tipo, const GLchar *codigo)
+{
+    GLuint shader = glCreateShader(tipo);
+    glShaderSource(shader, 1, &codigo, NULL);
+    glCompileShader(shader);
+
+    // Verifica erros de compilação
+    GLint sucesso;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &sucesso);
+    if (!sucesso)
+    {
+        GLint tamanhoLog = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &tamanhoLog);
+        vector<GLchar> infoLog(std::max(tamanhoLog, 1), '\0');
+        glGetShaderInfoLog(shader, (GLsizei)infoLog.size(), NULL, infoLog.data());
+        cerr << "Erro ao compilar o " << (tipo == GL_VERTEX_SHADER ? "vertex" : "fragment") << " shader:\n" << infoLog.data() << endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// Compila os dois estágios e vincula o programa (0 se algum passo falhar; o log do driver vai para o cerr)
+GLuint compilarPrograma(const GLchar *codigoVertex, const GLchar *codigoFragment)
+{
+    GLuint vertexShader = compilarShader(GL_VERTEX_SHADER, codigoVertex);
+    GLuint fragmentShader = compilarShader(GL_FRAGMENT_SHADER, codigoFragment);
+    if (!vertexShader || !fragmentShader)
+    {
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return 0;
+    }
+
+    // Cria o programa de shader e vincula os shaders (pedindo um binário que possa ir para o cache)
+    GLuint programaShader = glCreateProgram();
+    if (pglProgramParameteri)
+        pglProgramParameteri(programaShader, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glAttachShader(programaShader, vertexShader);
+    glAttachShader(programaShader, fragmentShader);
+    glLinkProgram(programaShader);
+
+    // Limpa os shaders depois de vinculados
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint sucesso;
+    glGetProgramiv(programaShader, GL_LINK_STATUS, &sucesso);
+    if (!sucesso)
+    {
+        GLint tamanhoLog = 0;
+        glGetProgramiv(programaShader, GL_INFO_LOG_LENGTH, &tamanhoLog);
+        vector<GLchar> infoLog(std::max(tamanhoLog, 1), '\0');
+        glGetProgramInfoLog(programaShader, (GLsizei)infoLog.size(), NULL, infoLog.data());
+        cerr << "Erro ao vincular o programa de shader:\n" << infoLog.data() << endl;
+        glDeleteProgram(programaShader);
+        return 0;
+    }
+    return programaShader;
+}
+
+// Monta o programa de shader. Com binários de programa, procura antes no cache em disco (chave: hash dos
+// dois fontes) e guarda lá o que precisou compilar. Se a compilação falhar o programa volta com id 0
+// (desenha nada, e os uniforms ficam inválidos) e o erro já foi mostrado.
+ProgramaShader configurarShader(const GLchar *codigoVertex, const GLchar *codigoFragment)
+{
+    double inicio = glfwGetTime();
+    uint64_t hashFontes = hashFNV1a(codigoFragment, strlen(codigoFragment), hashFNV1a(codigoVertex, strlen(codigoVertex)));
+    GLuint programaShader = 0;
+    if (pglProgramBinary)
+    {
+        if (!cacheProgramasLido)
+            lerCacheProgramas();
+        programaShader = carregarBinarioPrograma(hashFontes);
+    }
+    if (programaShader)
+    {
+        programasDoCache++;
+    }
+    else
+    {
+        programaShader = compilarPrograma(codigoVertex, codigoFragment);
+        if (programaShader)
+        {
+            programasCompilados++;
+            if (pglGetProgramBinary)
+                gravarBinarioPrograma(hashFontes, programaShader);
+        }
+    }
+    tempoProgramasMs += (glfwGetTime() - inicio) * 1000.0;
+
+    ProgramaShader programa;
+    programa.id = programaShader;
+    if (programaShader)
+        programa.refletir();
+    return programa;
+}
+
+// Monta o código de uma variante: versão do GLSL, um #define por recurso e o corpo do shader
+string montarFonteShader(uint32_t recursos, const GLchar *corpo)
+{
+    string fonte = "#version 400\n";
+    if (recursos & RECURSO_COR_SOLIDA)
+        fonte += "#define COR_SOLIDA\n";
+    if (recursos & RECURSO_TEXTURA)
+        fonte += "#define TEXTURA\n";
+    if (recursos & RECURSO_TINGIMENTO)
+        fonte += "#define TINGIMENTO\n";
+    if (recursos & RECURSO_UV_ANIMADO)
+        fonte += "#define UV_ANIMADO\n";
+    if (recursos & RECURSO_INSTANCIADO)
+        fonte += "#define INSTANCIADO\n";
+    if (recursos & RECURSO_ROLAGEM)
+        fonte += "#define ROLAGEM\n";
+    if (recursos & RECURSO_RECORTE)
+        fonte += "#define RECORTE\n";
+    if (recursos & RECURSO_SOBREPOSICAO)
+        fonte += "#define SOBREPOSICAO\n";
+    if (recursos & RECURSO_PALETA)
+        fonte += "#define PALETA\n";
+    return fonte + corpo;
+}
+
+// Retorna a variante do shader de sprites com os recursos pedidos, compilando na primeira vez
+ShaderSprite &obterVarianteShader(uint32_t recursos)
+{
+    static bool compilada[NUM_VARIANTES_SHADER] = {};
+    assert(recursos < (uint32_t)NUM_VARIANTES_SHADER);
+    ShaderSprite &shader = variantesShader[recursos];
+    if (compilada[recursos])
+        return shader;
+
+    string codigoVertex = montarFonteShader(recursos, codigoFonteVertexShader);
+    string codigoFragment = montarFonteShader(recursos, fragmentShaderSource);
+    shader.programa = configurarShader(codigoVertex.c_str(), codigoFragment.c_str());
+    shader.posicaoAngulo = shader.programa.uniforme<vec4>("posicao_angulo");
+    shader.escalaAncora = shader.programa.uniforme<vec4>("escala_ancora");
+    shader.texBuff = shader.programa.uniforme<int>("tex_buff");
+    shader.offsetTex = shader.programa.uniforme<vec2>("offset_tex");
+    shader.folhaAnimacao = shader.programa.uniforme<vec4>("folha_animacao");
+    shader.inicioAnimacao = shader.programa.uniforme<float>("inicio_animacao");
+    shader.uvRect = shader.programa.uniforme<vec4>("uv_rect");
+    shader.solidColor = shader.programa.uniforme<vec3>("solidColor");
+    shader.tint = shader.programa.uniforme<vec4>("tint");
+    shader.paleta = shader.programa.uniforme<int>("paleta");
+    shader.linhaPaleta = shader.programa.uniforme<int>("linha_paleta");
+    shader.programa.definir(shader.texBuff, 0);
+    shader.programa.definir(shader.paleta, UNIDADE_PALETA);
+    compilada[recursos] = true;
+    return shader;
+}
+
+// Variante escolhida em tempo de compilação (recursos incompatíveis não compilam)
+template <uint32_t RECURSOS>
+ShaderSprite &varianteShader()
+{
+    static_assert(RECURSOS < (uint32_t)NUM_VARIANTES_SHADER, "recurso de shader desconhecido");
+    static_assert(((RECURSOS & RECURSO_COR_SOLIDA) != 0) != ((RECURSOS & RECURSO_TEXTURA) != 0),
+                  "a variante precisa de exatamente uma fonte de cor: COR_SOLIDA ou TEXTURA");
+    static_assert(!(RECURSOS & RECURSO_UV_ANIMADO) || (RECURSOS & RECURSO_TEXTURA),
+                  "UV_ANIMADO só faz sentido com TEXTURA");
+    static_assert(!(RECURSOS & RECURSO_ROLAGEM) || ((RECURSOS & RECURSO_TEXTURA) && !(RECURSOS & RECURSO_UV_ANIMADO)),
+                  "ROLAGEM precisa de TEXTURA e não combina com UV_ANIMADO (rolar a folha mostraria o quadro vizinho)");
+    static_assert(!(RECURSOS & RECURSO_PALETA) || (RECURSOS & RECURSO_TEXTURA),
+                  "PALETA só faz sentido com TEXTURA");
+    return obterVarianteShader(RECURSOS);
+}
+
+// Configura um sprite com VAO e VBO: quadrado unitário com coordenadas de textura de 0 a 1
+// (o quadro da folha de sprites é escolhido no shader)
+int configurarSprite()
+{
+    if (renderSoftware) // Sem OpenGL não há VAO: o rasterizador monta o quad a partir da instância
+        return 0;
+
+    // Define os vértices do quadrado 
+    GLfloat vertices[] = {
+        // x    y    s    t
+        -0.5,  0.5, 0.0, 1.0, // Topo esquerdo
+        -0.5, -0.5, 0.0, 0.0, // Base esquerda
+         0.5,  0.5, 1.0, 1.0, // Topo direito
+        -0.5, -0.5, 0.0, 0.0, // Base esquerda 
+         0.5, -0.5, 1.0, 0.0, // Base direita
+         0.5,  0.5, 1.0, 1.0}; // Topo direito 
+
+    // Cria e configura o VBO
+    GLuint VBO, VAO;
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+    // Cria e configura o VAO
+    glGenVertexArrays(1, &VAO);
+    vincularVAO(VAO);
+    // Atributo 0 - Posição
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid *)0);
+    glEnableVertexAttribArray(0);
+    // Atributo 1 - Coordenadas de textura
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid *)(2 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(1);
+    // Desvincula buffers
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    vincularVAO(0);
+
+    return VAO;
+}
+
+// Configura um sprite com VAO e VBO e os atributos por instância (posição, escala, offset, UV, animação,
+// rotação, âncora e tingimento)
+int configurarSpriteInstanciado()
+{
+    if (renderSoftware)
+        return 0;
+
+    GLuint VAO = configurarSprite();
+
+    // Cria o buffer de streaming das instâncias, reescrito a cada frame
+    bufferInstancias.criar(GL_ARRAY_BUFFER, MAX_COMANDOS_RENDER * sizeof(DadosInstancia));
+    printf("Buffer de instancias: %s\n", bufferInstancias.persistente ? "mapeamento persistente" : "orphaning");
+
+    glBindBuffer(GL_ARRAY_BUFFER, bufferInstancias.id);
+    vincularVAO(VAO);
+    // Atributos 2 a 11 - Posição, escala, parallax, retângulo UV, animação, rotação, âncora, tingimento e
+    // variante de cor da instância
+    apontarAtributosInstancia(0);
+    for (GLuint atributo = 2; atributo <= 11; atributo++)
+    {
+        glEnableVertexAttribArray(atributo);
+        glVertexAttribDivisor(atributo, 1);
+    }
+    // Desvincula buffers
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    vincularVAO(0);
+
+    return VAO;
+}
+
+// Adiciona uma camada de parallax ao fundo. A textura precisa ser própria (fora do atlas) para
+// que GL_REPEAT faça a rolagem; use fatores múltiplos de 1/PERIODO_ROLAGEM para não haver salto.
+void adicionarCamadaFundo(GLuint idTextura, vec2 fatorParallax, bool translucida)
+{
+    if (numCamadasFundo >= MAX_CAMADAS_FUNDO)
+    {
+        cerr << "Camadas de fundo demais" << endl;
+        return;
+    }
+    Sprite &camada = camadasFundo[numCamadasFundo];
+    camada.VAO = configurarSprite();
+    camada.idTextura = idTextura;
+    camada.posicao = vec3(400, 300, PROFUNDIDADE_FUNDO + numCamadasFundo * 0.01f); // Centro da tela; as seguintes ficam à frente
+    camada.dimensoes = vec3(800, 600, 1);                                          // Cobre toda a tela
+    camada.angulo = 0.0;
+    camada.fatorParallax = fatorParallax;
+    camada.translucido = translucida;
+    numCamadasFundo++;
+}
+
+// Enfileira todas as camadas do fundo. A rolagem é feita no shader a partir de tempo.z, então o
+// custo na CPU não depende da velocidade. A chave do fundo ordena pela profundidade antes da textura:
+// a camada mais distante desenha antes e só camadas vizinhas com a mesma textura saem num único draw.
+void enfileirarFundo()
+{
+    for (int i = 0; i < numCamadasFundo; i++)
+    {
+        enfileirarSprite<SPRITE_ROLAGEM>(camadasFundo[i], CAMADA_FUNDO);
+    }
+}
+
+// Cria o uniform buffer das constantes do frame e o liga ao binding point compartilhado
+void criarConstantesFrame()
+{
+    constantesFrame.projecao = ortho(0.0, 800.0, 0.0, 600.0, -1.0, 1.0);
+    constantesFrame.visao = mat4(1);
+    constantesFrame.tempo = vec4(0.0f);
+    constantesFrame.escalaRender = vec4(1.0f, 1.0f, (float)larguraFramebuffer, (float)alturaFramebuffer);
+    if (renderSoftware) // O rasterizador lê a cópia na CPU
+        return;
+
+    glGenBuffers(1, &UBOConstantesFrame);
+    glBindBuffer(GL_UNIFORM_BUFFER, UBOConstantesFrame);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ConstantesFrame), &constantesFrame, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, PONTO_LIGACAO_CONSTANTES_FRAME, UBOConstantesFrame);
+}
+
+// Envia as constantes do frame: uma única atualização serve a todos os programas
+void atualizarConstantesFrame(float tempo, float deltaTempo)
+{
+    constantesFrame.tempo = vec4(tempo, deltaTempo, (float)fmod(distanciaEstrada, PERIODO_ROLAGEM), 0.0f);
+    constantesFrame.escalaRender = vec4(NIVEIS_QUALIDADE[governador.nivel].escala, NIVEIS_QUALIDADE[governador.nivel].escala,
+                                        (float)alvoRender.largura, (float)alvoRender.altura);
+    if (renderSoftware)
+        return;
+    glBindBuffer(GL_UNIFORM_BUFFER, UBOConstantesFrame);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ConstantesFrame), &constantesFrame);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// Callback de redimensionamento: recria o alvo interno para o novo tamanho (as constantes seguem no próximo frame)
+void redimensionarCallback(GLFWwindow *janela, int largura, int altura)
+{
+    if (largura <= 0 || altura <= 0) // Janela minimizada
+        return;
+    larguraFramebuffer = largura;
+    alturaFramebuffer = altura;
+    for (int i = 0; i < NUM_NIVEIS_QUALIDADE; i++)
+        governador.custoMs[i] = 0.0; // Os custos medidos valiam para o tamanho antigo
+    aplicarNivelQualidade(governador.nivel);
+    telaAlterada = true;
+}
+
+// (Re)cria o alvo fora da tela. Sem MSAA o jogo desenha direto na textura; com MSAA desenha em
+// renderbuffers multisample que são resolvidos (blit do mesmo tamanho) para a textura.
+bool criarAlvoRender(AlvoRender &alvo, int largura, int altura, int amostras, bool filtroLinear)
+{
+    glDeleteFramebuffers(1, &alvo.fbo);
+    glDeleteFramebuffers(1, &alvo.fboResolvido);
+    glDeleteRenderbuffers(1, &alvo.corMSAA);
+    glDeleteRenderbuffers(1, &alvo.profundidade);
+    glDeleteTextures(1, &alvo.textura);
+    vincularTextura(0, 0);
+    alvo = AlvoRender();
+
+    GLint maximoAmostras = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &maximoAmostras);
+    alvo.largura = largura;
+    alvo.altura = altura;
+    alvo.amostras = glm::min(amostras, (int)maximoAmostras);
+
+    // Textura com a cor final (filtro linear só quando for ampliada)
+    glGenTextures(1, &alvo.textura);
+    vincularTextura(0, alvo.textura);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filtroLinear ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filtroLinear ? GL_LINEAR : GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, largura, altura, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    vincularTextura(0, 0);
+
+    glGenRenderbuffers(1, &alvo.profundidade);
+    glBindRenderbuffer(GL_RENDERBUFFER, alvo.profundidade);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, alvo.amostras, GL_DEPTH_COMPONENT24, largura, altura);
+
+    glGenFramebuffers(1, &alvo.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, alvo.fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, alvo.profundidade);
+    if (alvo.amostras > 0)
+    {
+        glGenRenderbuffers(1, &alvo.corMSAA);
+        glBindRenderbuffer(GL_RENDERBUFFER, alvo.corMSAA);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, alvo.amostras, GL_RGBA8, largura, altura);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, alvo.corMSAA);
+    }
+    else
+    {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, alvo.textura, 0);
+    }
+    bool completo = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    if (alvo.amostras > 0)
+    {
+        glGenFramebuffers(1, &alvo.fboResolvido);
+        glBindFramebuffer(GL_FRAMEBUFFER, alvo.fboResolvido);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, alvo.textura, 0);
+        completo = completo && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (!completo)
+        cerr << "Framebuffer interno incompleto (" << largura << "x" << altura << ", " << alvo.amostras << " amostras)" << endl;
+    return completo;
+}
+
+// Troca o nível de qualidade e recria o alvo com a resolução e as amostras dele
+void aplicarNivelQualidade(int nivel)
+{
+    governador.nivel = glm::clamp(nivel, 0, NUM_NIVEIS_QUALIDADE - 1);
+    const NivelQualidade &qualidade = NIVEIS_QUALIDADE[governador.nivel];
+    int largura = glm::max(1, (int)(larguraFramebuffer * qualidade.escala));
+    int altura = glm::max(1, (int)(alturaFramebuffer * qualidade.escala));
+    bool ampliar = largura != larguraFramebuffer || altura != alturaFramebuffer;
+    if (renderSoftware)
+    {
+        // O alvo é a imagem do rasterizador (sem MSAA; os níveis com MSAA ficam iguais ao de 100%)
+        rasterizador.redimensionar(largura, altura);
+        alvoRender.largura = largura;
+        alvoRender.altura = altura;
+        alvoRender.amostras = 0;
+    }
+    else if (!criarAlvoRender(alvoRender, largura, altura, qualidade.amostras, ampliar) && qualidade.amostras > 0)
+        criarAlvoRender(alvoRender, largura, altura, 0, ampliar); // Sem suporte ao MSAA pedido: segue sem MSAA
+    governador.mediaMs = 0.0;
+    governador.framesMedidos = -1; // A primeira medição inclui a troca de nível: é descartada
+    printf("Qualidade: %s (%dx%d, %d amostras)\n", qualidade.nome, alvoRender.largura, alvoRender.altura, alvoRender.amostras);
+}
+
+// Começa o frame no alvo interno e inicia a medição do tempo de GPU
+void iniciarFrameAlvo()
+{
+    if (renderSoftware)
+        return;
+    glBindFramebuffer(GL_FRAMEBUFFER, alvoRender.fbo);
+    glViewport(0, 0, alvoRender.largura, alvoRender.altura);
+    if (!governador.pendente[governador.atual])
+        glBeginQuery(GL_TIME_ELAPSED, governador.consultasTempo[governador.atual]);
+}
+
+// Leva o alvo interno para a janela e encerra a medição do frame. No mesmo tamanho um único blit
+// copia (e resolve o MSAA); com escala resolve antes e desenha um triângulo que cobre a janela
+// amostrando a textura do alvo com filtro linear.
+void apresentarAlvoRender()
+{
+    if (renderSoftware)
+    {
+        // Pinta o frame na CPU; o tempo do rasterizador faz o papel do tempo de GPU no governador
+        rasterizador.renderizar();
+        registrarTempoFrame(rasterizador.ultimoTempoMs);
+        if (!modoHeadless) // Headless em software não tem contexto nem janela
+        {
+            // OpenGL 1.0 basta para copiar a imagem para a janela (ampliada se a escala for menor que 100%)
+            glViewport(0, 0, larguraFramebuffer, alturaFramebuffer);
+            glRasterPos2i(-1, -1);
+            glPixelZoom((float)larguraFramebuffer / rasterizador.largura, (float)alturaFramebuffer / rasterizador.altura);
+            glDrawPixels(rasterizador.largura, rasterizador.altura, GL_RGBA, GL_UNSIGNED_BYTE, rasterizador.cor.data());
+        }
+        return;
+    }
+
+    if (modoHeadless)
+    {
+        // Sem janela: a imagem fica no alvo (salvarImagemAlvo lê de lá); só fecha a medição de GPU
+    }
+    else if (alvoRender.largura == larguraFramebuffer && alvoRender.altura == alturaFramebuffer)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, alvoRender.fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, alvoRender.largura, alvoRender.altura, 0, 0, larguraFramebuffer, alturaFramebuffer,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+    else
+    {
+        if (alvoRender.amostras > 0)
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, alvoRender.fbo);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, alvoRender.fboResolvido);
+            glBlitFramebuffer(0, 0, alvoRender.largura, alvoRender.altura, 0, 0, alvoRender.largura, alvoRender.altura,
+                              GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, larguraFramebuffer, alturaFramebuffer);
+        ativarBlend(false);
+        ativarDepthTest(false);
+        programaApresentacao.usar();
+        vincularVAO(VAOApresentacao);
+        vincularTextura(0, alvoRender.textura);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        ativarBlend(true);
+        ativarDepthTest(true);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (!governador.pendente[governador.atual])
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        governador.pendente[governador.atual] = true;
+        governador.atual = 1 - governador.atual;
+    }
+}
+
+// Limpa o alvo do frame (no modo software descarta o que já foi pintado, cor e profundidade)
+void limparTela(vec4 cor, GLbitfield buffers)
+{
+    if (renderSoftware)
+    {
+        rasterizador.limpar(cor);
+        return;
+    }
+    glClearColor(cor.r, cor.g, cor.b, cor.a);
+    glClear(buffers);
+}
+
+// Lê a imagem atual do alvo interno em RGBA8, de cima para baixo (resolve o MSAA antes; as linhas do
+// OpenGL vêm de baixo para cima)
+vector<unsigned char> lerImagemAlvo()
+{
+    int largura = alvoRender.largura, altura = alvoRender.altura;
+    vector<unsigned char> pixels((size_t)largura * altura * 4);
+    if (renderSoftware)
+    {
+        memcpy(pixels.data(), rasterizador.cor.data(), pixels.size()); // Já na ordem de linhas do glReadPixels
+    }
+    else
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebufferLeituraAlvo());
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, largura, altura, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    vector<unsigned char> invertida(pixels.size());
+    size_t bytesLinha = (size_t)largura * 4;
+    for (int y = 0; y < altura; y++)
+        memcpy(&invertida[y * bytesLinha], &pixels[(altura - 1 - y) * bytesLinha], bytesLinha);
+    return invertida;
+}
+
+// Grava a imagem atual do alvo interno em PNG
+bool salvarImagemAlvo(const string &caminho)
+{
+    int largura = alvoRender.largura, altura = alvoRender.altura;
+    vector<unsigned char> imagem = lerImagemAlvo();
+    if (!stbi_write_png(caminho.c_str(), largura, altura, 4, imagem.data(), largura * 4))
+    {
+        cerr << "Falha ao gravar " << caminho << endl;
+        return false;
+    }
+    printf("Frame salvo em %s (%dx%d)\n", caminho.c_str(), largura, altura);
+    return true;
+}
+
+// Compara a imagem atual do alvo com um PNG de referência (normalmente o mesmo frame desenhado pelo outro
+// renderizador): cada canal pode diferir até TOLERANCIA_COMPARACAO e só uma fração pequena dos pixels pode
+// passar disso. Mostra o resultado (com a diferença média por canal) e retorna se a imagem passou.
+bool compararImagemAlvo(const string &caminhoReferencia)
+{
+    int largura, altura, canais;
+    unsigned char *referencia = stbi_load(caminhoReferencia.c_str(), &largura, &altura, &canais, 4);
+    if (!referencia)
+    {
+        cerr << "Falha ao carregar a referencia " << caminhoReferencia << endl;
+        return false;
+    }
+    if (largura != alvoRender.largura || altura != alvoRender.altura)
+    {
+        cerr << "Referencia " << caminhoReferencia << " tem " << largura << "x" << altura << ", o frame tem "
+             << alvoRender.largura << "x" << alvoRender.altura << endl;
+        stbi_image_free(referencia);
+        return false;
+    }
+
+    vector<unsigned char> imagem = lerImagemAlvo();
+    int foraTolerancia = 0, maiorDiferenca = 0;
+    double somaDiferencas = 0.0;
+    for (size_t i = 0; i < imagem.size(); i += 4)
+    {
+        int diferenca = 0;
+        for (int canal = 0; canal < 3; canal++) // O alpha do alvo não aparece na tela
+        {
+            int diferencaCanal = abs((int)imagem[i + canal] - (int)referencia[i + canal]);
+            somaDiferencas += diferencaCanal;
+            diferenca = std::max(diferenca, diferencaCanal);
+        }
+        maiorDiferenca = std::max(maiorDiferenca, diferenca);
+        if (diferenca > TOLERANCIA_COMPARACAO)
+            foraTolerancia++;
+    }
+    stbi_image_free(referencia);
+
+    double numPixels = (double)largura * altura;
+    double fracao = foraTolerancia / numPixels;
+    bool passou = fracao <= FRACAO_MAXIMA_FORA_TOLERANCIA;
+    printf("Comparacao com %s: %d pixels (%.3f%%) acima de %d, diferenca media %.3f, maior %d -> %s\n",
+           caminhoReferencia.c_str(), foraTolerancia, fracao * 100.0, TOLERANCIA_COMPARACAO, somaDiferencas / (numPixels * 3),
+           maiorDiferenca, passou ? "OK" : "FALHOU");
+    return passou;
+}
+
+// Framebuffer de onde ler a imagem do alvo interno (com MSAA resolve antes no alvo resolvido)
+GLuint framebufferLeituraAlvo()
+{
+    if (alvoRender.amostras == 0)
+        return alvoRender.fbo;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, alvoRender.fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, alvoRender.fboResolvido);
+    glBlitFramebuffer(0, 0, alvoRender.largura, alvoRender.altura, 0, 0, alvoRender.largura, alvoRender.altura,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return alvoRender.fboResolvido;
+}
+
+// Manda o frame recém-desenhado para o vídeo e para a captura se uma foto (tecla C) ou um clipe foi pedido;
+// nos outros frames só entrega as leituras que a GPU já terminou. Nada aqui espera a GPU nem a gravação.
+void capturarFrame()
+{
+    if (gravador.ativo())
+    {
+        if (renderSoftware)
+            gravador.copiarImagem(rasterizador.cor.data(), rasterizador.largura, rasterizador.altura);
+        else
+            gravador.lerFramebuffer(framebufferLeituraAlvo(), alvoRender.largura, alvoRender.altura);
+    }
+
+    char caminho[64];
+    if (gravandoClipe)
+    {
+        snprintf(caminho, sizeof(caminho), FORMATO_ARQUIVO_CLIPE, numeroClipe, quadroClipe++);
+        if (quadrosClipeArgumento > 0 && quadroClipe >= quadrosClipeArgumento)
+        {
+            quadrosClipeArgumento = 0;
+            alternarClipe();
+        }
+    }
+    else if (pedidoCapturaTela)
+        snprintf(caminho, sizeof(caminho), FORMATO_ARQUIVO_CAPTURA, numeroCaptura++);
+    else
+    {
+        captura.anel.coletar(false);
+        return;
+    }
+    pedidoCapturaTela = false;
+
+    if (renderSoftware)
+        captura.copiarImagem(rasterizador.cor.data(), rasterizador.largura, rasterizador.altura, caminho);
+    else
+        captura.lerFramebuffer(framebufferLeituraAlvo(), alvoRender.largura, alvoRender.altura, caminho);
+}
+
+// Começa ou termina a gravação de um clipe (um PNG por frame)
+void alternarClipe()
+{
+    gravandoClipe = !gravandoClipe;
+    if (gravandoClipe)
+    {
+        quadroClipe = 0;
+        printf("Clipe %d: gravando um PNG por frame\n", numeroClipe);
+    }
+    else
+        printf("Clipe %d: %d quadros\n", numeroClipe++, quadroClipe);
+}
+
+// Relógio da simulação. Gravando vídeo (ou comparando renderizadores) é virtual: cada frame avança
+// exatamente 1/fps, não importa quanto ele demorou (nem se o disco atrasou), então a mesma semente gera
+// sempre os mesmos frames.
+double relogioJogo()
+{
+    if (relogioVirtual)
+        return (double)quadrosRelogioVirtual / fpsVideo;
+    return glfwGetTime();
+}
+
+// Lê o tempo de GPU de um frame anterior (sem esperar) e troca de nível se a média ficou fora da faixa
+void atualizarGovernador()
+{
+    GLuint64 nanossegundos = 0;
+    if (lerConsultasProntas(governador.consultasTempo, governador.pendente, governador.atual, nanossegundos))
+        registrarTempoFrame(nanossegundos / 1.0e6);
+}
+
+// Acumula o tempo de um frame (de GPU, ou da CPU no modo software) e troca de nível se a média
+// ficou fora da faixa
+void registrarTempoFrame(double tempoMs)
+{
+    if (governador.framesMedidos < 0)
+    {
+        governador.framesMedidos = 0;
+        return;
+    }
+    governador.mediaMs = governador.framesMedidos == 0 ? tempoMs : governador.mediaMs * 0.9 + tempoMs * 0.1;
+    governador.framesMedidos++;
+    if (governador.framesMedidos < FRAMES_PARA_REDUZIR)
+        return;
+    governador.custoMs[governador.nivel] = governador.mediaMs;
+    if (!governador.automatico)
+        return;
+
+    // Acima do orçamento: vai para o melhor nível já medido que cabe; senão experimenta um nível mais
+    // barato ainda não medido; senão fica com o mais barato medido. Os custos medidos importam porque
+    // em rasterizadores por software a ampliação pode custar mais do que a resolução menor economiza.
+    if (governador.mediaMs > governador.orcamentoMs * FRACAO_REDUZIR)
+    {
+        int escolhido = -1;
+        for (int nivel = 0; nivel < NUM_NIVEIS_QUALIDADE && escolhido < 0; nivel++)
+            if (nivel != governador.nivel && governador.custoMs[nivel] > 0.0 &&
+                governador.custoMs[nivel] < governador.orcamentoMs * FRACAO_REDUZIR)
+                escolhido = nivel;
+        for (int nivel = governador.nivel + 1; nivel < NUM_NIVEIS_QUALIDADE && escolhido < 0; nivel++)
+            if (governador.custoMs[nivel] == 0.0)
+                escolhido = nivel;
+        for (int nivel = 0; nivel < NUM_NIVEIS_QUALIDADE && escolhido < 0; nivel++)
+            if (governador.custoMs[nivel] > 0.0 && governador.custoMs[nivel] < governador.mediaMs * FRACAO_REDUZIR)
+                escolhido = nivel;
+        if (escolhido >= 0)
+            aplicarNivelQualidade(escolhido);
+    }
+    // Aumenta um nível depois de um bom tempo com folga, se ele não estourou o orçamento antes
+    else if (governador.framesMedidos >= FRAMES_PARA_AUMENTAR && governador.mediaMs < governador.orcamentoMs * FRACAO_AUMENTAR &&
+             governador.nivel > 0)
+    {
+        double custoAcima = governador.custoMs[governador.nivel - 1];
+        if (custoAcima == 0.0 || custoAcima < governador.orcamentoMs * FRACAO_REDUZIR)
+            aplicarNivelQualidade(governador.nivel - 1);
+    }
+}
+
+// Reinicia o jogo para o estado inicial
+void reiniciarJogo()
+{
+    mudarEstadoJogo(MENU);               // Volta para o menu
+    jogador.posicao = vec3(300, 100, PROFUNDIDADE_JOGADOR); // Reposiciona jogador
+    // Remove todos os inimigos
+    for (int j = 0; j < MAX_INIMIGOS; j++)
+    {
+        inimigos[j].posicao = vec3(-100.0f, -100.0f, PROFUNDIDADE_INIMIGOS);
+    }
+    temporizadorAparecerInimigos = 0.0f; // Reseta temporizador
+}
+
+// Desenha um sprite na tela com a variante de shader escolhida por RECURSOS.
+// 'cor' é a cor sólida (COR_SOLIDA) ou a cor de tingimento (TINGIMENTO); ignorada nos outros casos.
+template <uint32_t RECURSOS>
+void drawSprite(const Sprite &sprite, vec4 cor)
+{
+    if (renderSoftware)
+    {
+        // Sem instancing o shader ignora o tingimento do sprite: só a cor sólida ou o TINGIMENTO contam
+        DadosInstancia instancia = montarInstancia(sprite);
+        vec4 tingimento = (RECURSOS & (RECURSO_COR_SOLIDA | RECURSO_TINGIMENTO)) ? cor : vec4(1.0f);
+        instancia.tingimento = u8vec4(glm::clamp(tingimento, 0.0f, 1.0f) * 255.0f + 0.5f);
+        rasterizador.adicionar(quadDaInstancia(instancia, sprite.idTextura, RECURSOS, true));
+        if (!(RECURSOS & RECURSO_COR_SOLIDA))
+            marcarEntradaAtlasUsada(sprite.entradaAtlas);
+        contadorSpritesDesenhados++;
+        return;
+    }
+    // Texturas indexadas trocam de variante em tempo de execução (a paleta é da textura, não do sprite)
+    GLuint paleta = (RECURSOS & RECURSO_TEXTURA) ? paletaDaTextura(sprite.idTextura) : 0;
+    ShaderSprite &shader = paleta ? obterVarianteShader(RECURSOS | RECURSO_PALETA) : varianteShader<RECURSOS>();
+    shader.programa.usar();
+    vincularVAO(sprite.VAO);
+    if (RECURSOS & RECURSO_COR_SOLIDA)
+    {
+        shader.programa.definir(shader.solidColor, vec3(cor));
+    }
+    else
+    {
+        vincularTextura(0, sprite.idTextura);
+        if (paleta)
+        {
+            vincularTextura(UNIDADE_PALETA, paleta);
+            shader.programa.definir(shader.linhaPaleta, sprite.linhaPaleta);
+        }
+        shader.programa.definir(shader.uvRect, sprite.uvAtlas);
+        marcarEntradaAtlasUsada(sprite.entradaAtlas);
+    }
+    if (RECURSOS & RECURSO_UV_ANIMADO)
+    {
+        vec4 folha = vec4(sprite.numQuadros, sprite.numAnimacoes, sprite.animacaoAtual, sprite.quadrosPorSegundo);
+        shader.programa.definir(shader.folhaAnimacao, folha);
+        shader.programa.definir(shader.inicioAnimacao, sprite.inicioAnimacao);
+    }
+    if (RECURSOS & RECURSO_ROLAGEM)
+    {
+        shader.programa.definir(shader.offsetTex, sprite.fatorParallax);
+    }
+    if (RECURSOS & RECURSO_TINGIMENTO)
+    {
+        shader.programa.definir(shader.tint, cor);
+    }
+    // Posição, rotação, escala e âncora: o shader monta a transformação (sem matriz na CPU)
+    shader.programa.definir(shader.posicaoAngulo, vec4(sprite.posicao, sprite.angulo));
+    shader.programa.definir(shader.escalaAncora, vec4(vec2(sprite.dimensoes), sprite.ancora));
+    // Desenha os triângulos
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    contadorDrawCalls++;
+    contadorSpritesDesenhados++;
+}
+
+// Verifica se a imagem tem alpha parcial. Alpha só 0 ou 255 é recorte: desenha no passe opaco com discard
+bool imagemTranslucida(const unsigned char *dados, int numPixels, int nrCanais)
+{
+    if (nrCanais != 2 && nrCanais != 4) // Só cinza+alpha e RGBA têm alpha (o último canal)
+        return false;
+    for (int i = 0; i < numPixels; i++)
+    {
+        unsigned char alpha = dados[i * nrCanais + nrCanais - 1];
+        if (alpha != 0 && alpha != 255)
+            return true;
+    }
+    return false;
+}
+
+// Cria uma textura imutável (glTexStorage2D) no formato dos canais da imagem e envia o nível 0 por um pixel
+// unpack buffer: o glTexSubImage2D só agenda a cópia e volta, em vez de segurar a CPU enquanto o driver lê
+// a imagem. Imagens maiores que a região do buffer de envio usam um buffer temporário do tamanho delas.
+// Os mipmaps, se a política pedir, são gerados na GPU.
+GLuint criarTextura2D(const unsigned char *dados, int largura, int altura, int canais, GLenum repeticao, GLenum filtro,
+                      PoliticaMipmap mipmaps)
+{
+    const FormatoTextura &formato = FORMATOS_TEXTURA[canais - 1];
+    int niveis = 1;
+    if (mipmaps == MIPMAPS_GERADOS)
+        while ((std::max(largura, altura) >> niveis) > 0)
+            niveis++;
+
+    GLuint idTextura;
+    glGenTextures(1, &idTextura);
+    vincularTextura(0, idTextura);
+    if (pglTexStorage2D)
+        pglTexStorage2D(GL_TEXTURE_2D, niveis, formato.formatoInterno, largura, altura);
+    else
+    {
+        // Sem texturas imutáveis: os mesmos níveis no mesmo formato, alocados um a um
+        for (int nivel = 0; nivel < niveis; nivel++)
+            glTexImage2D(GL_TEXTURE_2D, nivel, formato.formatoInterno, std::max(1, largura >> nivel), std::max(1, altura >> nivel), 0,
+                         formato.formato, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, niveis - 1);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, repeticao);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, repeticao);
+    GLenum filtroReducao = filtro;
+    if (niveis > 1)
+        filtroReducao = filtro == GL_LINEAR ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST_MIPMAP_LINEAR;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filtroReducao);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filtro);
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, formato.swizzle);
+
+    // Linhas de 1 a 3 bytes por pixel nem sempre são múltiplas de 4 (o alinhamento padrão do OpenGL)
+    GLsizeiptr bytesLinha = (GLsizeiptr)largura * canais;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, bytesLinha % 4 == 0 ? 4 : 1);
+    GLsizeiptr bytes = bytesLinha * altura;
+    GLintptr offset = 0;
+    void *destino = nullptr;
+    GLuint bufferTemporario = 0;
+    if (bytes <= bufferEnvioTexturas.capacidade())
+    {
+        destino = bufferEnvioTexturas.reservar(bytes, offset);
+        if (!destino) // A região deste frame encheu: passa para a próxima
+        {
+            bufferEnvioTexturas.fimDoFrame();
+            destino = bufferEnvioTexturas.reservar(bytes, offset);
+        }
+    }
+    else
+    {
+        // Não cabe na região: um buffer só para esta imagem. Apagá-lo logo depois é seguro, o driver só
+        // libera a memória quando a cópia para a textura terminar
+        glGenBuffers(1, &bufferTemporario);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, bufferTemporario);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+        destino = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    }
+    if (destino)
+    {
+        memcpy(destino, dados, bytes);
+        if (bufferTemporario)
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        else
+            bufferEnvioTexturas.concluirEscrita();
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, largura, altura, formato.formato, GL_UNSIGNED_BYTE, (GLvoid *)offset);
+    }
+    else
+    {
+        // Sem buffer mapeado (o driver recusou o mapeamento): envio síncrono a partir da memória da CPU
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, largura, altura, formato.formato, GL_UNSIGNED_BYTE, dados);
     }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); // Envios seguintes com ponteiro da CPU não podem ler do buffer
+    if (bufferTemporario)
+        glDeleteBuffers(1, &bufferTemporario);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (niveis > 1)
+        glGenerateMipmap(GL_TEXTURE_2D);
+    vincularTextura(0, 0);
+    return idTextura;
+}
 
-    // Move todos os inimigos ativos
-    for (int i = 0; i < MAX_INIMIGOS; i++)
+// Carrega uma textura de arquivo com GL_REPEAT ('translucida', se pedido, diz se ela precisa de blending)
+int carregarTextura(string caminhoArquivo, bool *translucida, PoliticaMipmap mipmaps)
+{
+    // Carrega imagem do arquivo (1 a 4 canais, como estiver no arquivo)
+    int largura, altura, nrCanais;
+    unsigned char *dados = stbi_load(caminhoArquivo.c_str(), &largura, &altura, &nrCanais, 0);
+    if (!dados)
     {
-        if (inimigos[i].posicao.y > -50.0f) // Se está na tela
+        cout << "Falha ao carregar textura " << caminhoArquivo << endl;
+        return 0;
+    }
+    if (translucida)
+        *translucida = imagemTranslucida(dados, largura * altura, nrCanais);
+
+    // Modo software: a textura fica na memória do rasterizador. Na GPU, imagens coloridas com poucas cores
+    // viram textura indexada (mipmaps de índices não fazem sentido, então só sem mipmaps).
+    GLuint idTextura;
+    vector<unsigned char> indices, paleta;
+    if (renderSoftware)
+        idTextura = rasterizador.criarTextura(dados, largura, altura, nrCanais, true);
+    else if (mipmaps == SEM_MIPMAPS && nrCanais >= 3 && indexarCores(dados, largura * altura, nrCanais, indices, paleta) > 0)
+        idTextura = criarTexturaIndexada(indices, paleta, largura, altura, GL_REPEAT);
+    else
+        idTextura = criarTextura2D(dados, largura, altura, nrCanais, GL_REPEAT, GL_NEAREST, mipmaps);
+
+    // Libera memória da imagem
+    stbi_image_free(dados);
+    return idTextura;
+}
+
+// Troca cada pixel pelo índice da sua cor exata (sem perda), se a imagem tiver no máximo CORES_PALETA cores.
+// 'paleta' sai com CORES_PALETA cores RGBA (as que sobram ficam transparentes; sem alpha, a cor é opaca).
+// Retorna o número de cores ou 0 se houver cores demais.
+int indexarCores(const unsigned char *dados, int numPixels, int nrCanais, vector<unsigned char> &indices,
+                 vector<unsigned char> &paleta)
+{
+    unordered_map<uint32_t, unsigned char> indiceDaCor;
+    indices.resize(numPixels);
+    paleta.assign(CORES_PALETA * 4, 0);
+    uint32_t corAnterior = 0;
+    int indiceAnterior = -1; // Sprites têm longas sequências da mesma cor: evita a busca no mapa
+    for (int i = 0; i < numPixels; i++)
+    {
+        const unsigned char *pixel = dados + (size_t)i * nrCanais;
+        unsigned char rgba[4] = {pixel[0], pixel[1], pixel[2], nrCanais == 4 ? pixel[3] : (unsigned char)255};
+        uint32_t cor;
+        memcpy(&cor, rgba, 4);
+        if (indiceAnterior < 0 || cor != corAnterior)
         {
-            inimigos[i].posicao.y -= inimigos[i].velocidade; // Move para baixo
-            if (inimigos[i].posicao.y < -50.0f)              // Saiu da tela
+            auto encontrada = indiceDaCor.find(cor);
+            if (encontrada == indiceDaCor.end())
             {
-                inimigos[i].posicao = vec3(-100.0f, -100.0f, 0.0f); // Remove
+                if ((int)indiceDaCor.size() == CORES_PALETA)
+                    return 0;
+                unsigned char novo = (unsigned char)indiceDaCor.size();
+                encontrada = indiceDaCor.emplace(cor, novo).first;
+                memcpy(&paleta[novo * 4], rgba, 4);
             }
+            corAnterior = cor;
+            indiceAnterior = encontrada->second;
         }
+        indices[i] = (unsigned char)indiceAnterior;
     }
+    return (int)indiceDaCor.size();
 }
 
-// Desenha todos os inimigos na tela
-void drawInimigos(GLuint idShader)
+// Cria a textura de índices (R8, um quarto da memória e da banda de uma RGBA8) e a textura da paleta
+// (uma linha por variante de cor) e registra o par: quem desenha com a textura de índices usa a variante
+// PALETA e vincula a paleta na UNIDADE_PALETA. Trocar a paleta recolore tudo sem mexer nos índices.
+// Sempre GL_NEAREST e sem mipmaps: filtrar índices misturaria cores sem relação entre si.
+GLuint criarTexturaIndexada(const vector<unsigned char> &indices, const vector<unsigned char> &paleta, int largura, int altura,
+                            GLenum repeticao)
 {
-    if (estadoJogo != JOGANDO) // Só desenha se estiver jogando
-        return;
+    GLuint idTextura = criarTextura2D(indices.data(), largura, altura, 1, repeticao, GL_NEAREST, SEM_MIPMAPS);
+    int linhas = (int)(paleta.size() / (CORES_PALETA * 4));
+    paletasTexturas[idTextura] = criarTextura2D(paleta.data(), CORES_PALETA, linhas, 4, GL_CLAMP_TO_EDGE, GL_NEAREST, SEM_MIPMAPS);
+    return idTextura;
+}
 
-    for (int i = 0; i < MAX_INIMIGOS; i++)
+// Acrescenta à paleta (uma linha de CORES_PALETA cores) as linhas 1 a linhas - 1, cada uma com o matiz
+// girado e a saturação mudada. As duas mexem só na parte da cor fora do eixo cinza do RGB: o giro é em
+// torno desse eixo e a saturação escala a distância até ele. Cinzas (pneus, vidros, contornos, brilhos
+// brancos) continuam iguais e só as partes coloridas mudam. Com os índices iguais, cada linha é um
+// sprite novo de graça.
+void gerarVariantesPaleta(vector<unsigned char> &paleta, int linhas)
+{
+    paleta.resize((size_t)CORES_PALETA * 4 * linhas);
+    for (int linha = 1; linha < linhas; linha++)
     {
-        if (inimigos[i].posicao.y > -50.0f) // Se está na tela
+        float matiz = 360.0f * (linha % MATIZES_VARIANTES) / MATIZES_VARIANTES;
+        float saturacao = SATURACAO_VARIANTES[(linha / MATIZES_VARIANTES) % (LINHAS_PALETA_ATLAS / MATIZES_VARIANTES)];
+        mat4 giro = rotate(mat4(1.0f), radians(matiz), vec3(1.0f));
+        for (int i = 0; i < CORES_PALETA; i++)
         {
-            // Calcula deslocamento de textura para animação
-            float ds = inimigos[i].quadroAtual * inimigos[i].ds;
-            float dt = inimigos[i].animacaoAtual * inimigos[i].dt;
-            glUniform2f(glGetUniformLocation(idShader, "offset_tex"), ds, dt);
-            drawSprite(idShader, inimigos[i]); // Desenha o inimigo
+            const unsigned char *original = &paleta[i * 4];
+            unsigned char *cor = &paleta[((size_t)linha * CORES_PALETA + i) * 4];
+            vec3 girado = vec3(giro * vec4(original[0], original[1], original[2], 0.0f));
+            float cinza = (original[0] + original[1] + original[2]) / 3.0f; // Projeção no eixo cinza (o giro não a muda)
+            vec3 rgb = glm::clamp(vec3(cinza) + (girado - vec3(cinza)) * saturacao, 0.0f, 255.0f);
+            cor[0] = (unsigned char)(rgb.r + 0.5f);
+            cor[1] = (unsigned char)(rgb.g + 0.5f);
+            cor[2] = (unsigned char)(rgb.b + 0.5f);
+            cor[3] = original[3];
         }
     }
 }
 
-// Verifica colisão entre dois sprites usando bounding boxes
-bool verificarColisao(const Sprite &a, const Sprite &b)
+// Paleta de uma textura indexada (0 se a textura guarda as cores direto)
+GLuint paletaDaTextura(GLuint textura)
 {
-    // Calcula os limites do sprite A
-    float aEsquerda = a.posicao.x - a.dimensoes.x * 0.2f;
-    float aDireita = a.posicao.x + a.dimensoes.x * 0.2f;
-    float aTopo = a.posicao.y + a.dimensoes.y * 0.2f;
-    float aBase = a.posicao.y - a.dimensoes.y * 0.2f;
-
-    // Calcula os limites do sprite B
-    float bEsquerda = b.posicao.x - b.dimensoes.x * 0.2f;
-    float bDireita = b.posicao.x + b.dimensoes.x * 0.2f;
-    float bTopo = b.posicao.y + b.dimensoes.y * 0.2f;
-    float bBase = b.posicao.y - b.dimensoes.y * 0.2f;
-
-    // Verifica sobreposição nas duas dimensões
-    return (aDireita > bEsquerda && aEsquerda < bDireita && aTopo > bBase && aBase < bTopo);
+    auto encontrada = paletasTexturas.find(textura);
+    return encontrada == paletasTexturas.end() ? 0 : encontrada->second;
 }
 
-// Verifica se o mouse está sobre um botão
-bool mouseSobreBotao(vec2 posicaoMouse, Botao botao)
+// Empacota as imagens em uma única textura (skyline bottom-left), com 1 pixel de borda por sprite
+bool construirAtlas(AtlasTexturas &atlas, const vector<string> &caminhos)
 {
-    return (posicaoMouse.x > botao.posicao.x - botao.tamanho.x / 2 &&
-            posicaoMouse.x < botao.posicao.x + botao.tamanho.x / 2 &&
-            posicaoMouse.y > botao.posicao.y - botao.tamanho.y / 2 &&
-            posicaoMouse.y < botao.posicao.y + botao.tamanho.y / 2);
-}
+    const int BORDA = 1;          // Borda replicada em volta de cada sprite (evita vazamento na amostragem)
+    const int TAMANHO_MAXIMO = 4096;
 
-// Renderiza o menu com os botões
-void renderizarMenu(GLuint idShader)
-{
-    // Limpa a tela com cor escura
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    // Até o atlas ficar pronto toda entrada usa a textura 0 inteira (preta, como uma textura que não carregou)
+    atlas.idTextura = 0;
+    atlas.linhasPaleta = 1;
+    atlas.entradas.clear();
+    for (size_t i = 0; i < caminhos.size(); i++)
+        atlas.entradas.push_back({caminhos[i], 0, 0, 0, 0, vec4(0.0f, 0.0f, 1.0f, 1.0f), false});
 
-    // Desenha cada botão
-    for (int i = 0; i < 2; i++)
+    // Carrega todas as imagens como RGBA
+    struct ImagemAtlas
     {
-        Sprite spriteBotao;
-        spriteBotao.VAO = configurarSprite(1, 1, spriteBotao.ds, spriteBotao.dt);
-        spriteBotao.posicao = vec3(botoes[i].posicao.x, botoes[i].posicao.y, 0);
-        spriteBotao.dimensoes = vec3(botoes[i].tamanho.x, botoes[i].tamanho.y, 1);
-        spriteBotao.idTextura = 0;
-
-        // Obtém posição do mouse
-        double xpos, ypos;
-        glfwGetCursorPos(janela, &xpos, &ypos);
-        ypos = ALTURA - ypos; 
-        bool mouseSobre = mouseSobreBotao(vec2(xpos, ypos), botoes[i]);
-
-        // Define cor do botão normal e hover
-        vec3 corBotao = botoes[i].cor;
-        if (mouseSobre)
-        {
-            if (i == 0)                       // Botão PLAY
-                corBotao = COR_HOVER_INICIAR; // Vermelho claro
-            else                              // Botão SAIR
-                corBotao = COR_HOVER_SAIR;    // Roxo claro
-        }
-
-        // Define a cor uniforme no shader
-        glUniform3f(glGetUniformLocation(idShader, "solidColor"),
-                    corBotao.r, corBotao.g, corBotao.b);
-        drawSprite(idShader, spriteBotao, true); 
-    }
-}
-
-// Callback para clique do mouse no menu
-void mouseCallbackMenu(GLFWwindow *janela, int botao, int acao, int mods)
-{
-    if (estadoJogo == MENU && botao == GLFW_MOUSE_BUTTON_LEFT && acao == GLFW_PRESS)
+        unsigned char *dados;
+        int largura, altura, indice;
+    };
+    vector<ImagemAtlas> imagens;
+    for (size_t i = 0; i < caminhos.size(); i++)
     {
-        // Obtém posição do mouse
-        double xpos, ypos;
-        glfwGetCursorPos(janela, &xpos, &ypos);
-        ypos = ALTURA - ypos; // Inverte eixo Y
-
-        // Verifica cada botão
-        for (int i = 0; i < 2; i++)
+        ImagemAtlas imagem;
+        int nrCanais;
+        imagem.dados = stbi_load(caminhos[i].c_str(), &imagem.largura, &imagem.altura, &nrCanais, 4);
+        imagem.indice = (int)i;
+        if (!imagem.dados)
         {
-            if (mouseSobreBotao(vec2(xpos, ypos), botoes[i]))
-            {
-                if (i == 0) // Botão Iniciar
-                {
-                    estadoJogo = JOGANDO;                // Muda para estado de jogo
-                    jogador.posicao = vec3(300, 100, 0); // Reposiciona jogador
-                }
-                else // Botão Sair
-                {
-                    glfwSetWindowShouldClose(janela, GL_TRUE); // Fecha o jogo
-                }
-            }
+            cout << "Falha ao carregar textura do atlas: " << caminhos[i] << endl;
+            for (size_t j = 0; j < imagens.size(); j++)
+                stbi_image_free(imagens[j].dados);
+            return false;
         }
+        imagens.push_back(imagem);
     }
-}
 
-// Callback para teclado (usado no menu e no jogo)
-void tecladoCallbackMenu(GLFWwindow *janela, int tecla, int scancode, int acao, int modo)
-{
-    // Tecla ESC - volta para o menu ou sai
-    if (tecla == GLFW_KEY_ESCAPE && acao == GLFW_PRESS)
+    // Empacota das mais altas para as mais baixas, dobrando o atlas até caber tudo
+    vector<ImagemAtlas> ordenadas = imagens;
+    for (size_t i = 1; i < ordenadas.size(); i++)
+        for (size_t j = i; j > 0 && ordenadas[j].altura > ordenadas[j - 1].altura; j--)
+            std::swap(ordenadas[j], ordenadas[j - 1]);
+
+    EmpacotadorSkyline empacotador;
+    vector<ivec2> posicoes(imagens.size());
+    int largura = 64, altura = 64;
+    bool coube = false;
+    while (!coube && largura <= TAMANHO_MAXIMO)
     {
-        if (estadoJogo == JOGANDO)
+        empacotador.iniciar(largura, altura);
+        coube = true;
+        for (size_t i = 0; i < ordenadas.size() && coube; i++)
         {
-            estadoJogo = MENU; // Volta ao menu
+            int x, y;
+            coube = empacotador.inserir(ordenadas[i].largura + 2 * BORDA, ordenadas[i].altura + 2 * BORDA, x, y);
+            posicoes[ordenadas[i].indice] = ivec2(x + BORDA, y + BORDA);
         }
-        else
+        if (!coube)
         {
-            glfwSetWindowShouldClose(janela, GL_TRUE); // Sai do jogo
+            if (altura < largura)
+                altura *= 2;
+            else
+                largura *= 2;
         }
     }
+    if (!coube)
+    {
+        cout << "Sprites não cabem no atlas " << TAMANHO_MAXIMO << "x" << TAMANHO_MAXIMO << endl;
+        for (size_t i = 0; i < imagens.size(); i++)
+            stbi_image_free(imagens[i].dados);
+        return false;
+    }
 
-    // Atualiza array de teclas pressionadas
-    if (acao == GLFW_PRESS)
+    // Copia cada sprite (e sua borda replicada) para a imagem do atlas
+    vector<unsigned char> pixels(largura * altura * 4, 0);
+    atlas.entradas.clear();
+    for (size_t i = 0; i < imagens.size(); i++)
     {
-        teclas[tecla] = true;
-        // Enter no menu inicia o jogo
-        if (estadoJogo == MENU && tecla == GLFW_KEY_ENTER)
+        const ImagemAtlas &imagem = imagens[i];
+        int x0 = posicoes[i].x, y0 = posicoes[i].y;
+        for (int y = -BORDA; y < imagem.altura + BORDA; y++)
         {
-            estadoJogo = JOGANDO;
-            jogador.posicao = vec3(300, 100, 0);
-            // Reseta posição dos inimigos
-            for (int j = 0; j < MAX_INIMIGOS; j++)
+            int yOrigem = glm::clamp(y, 0, imagem.altura - 1);
+            for (int x = -BORDA; x < imagem.largura + BORDA; x++)
             {
-                inimigos[j].posicao = vec3(-100.0f, -100.0f, 0.0f);
+                int xOrigem = glm::clamp(x, 0, imagem.largura - 1);
+                memcpy(&pixels[((y0 + y) * largura + (x0 + x)) * 4],
+                       &imagem.dados[(yOrigem * imagem.largura + xOrigem) * 4], 4);
             }
         }
+
+        EntradaAtlas entrada;
+        entrada.caminho = caminhos[i];
+        entrada.x = x0;
+        entrada.y = y0;
+        entrada.largura = imagem.largura;
+        entrada.altura = imagem.altura;
+        entrada.uv = vec4((float)x0 / largura, (float)y0 / altura,
+                          (float)imagem.largura / largura, (float)imagem.altura / altura);
+        entrada.translucida = imagemTranslucida(imagem.dados, imagem.largura * imagem.altura, 4);
+        atlas.entradas.push_back(entrada);
+        stbi_image_free(imagem.dados);
     }
-    else if (acao == GLFW_RELEASE)
+
+    // Sprites de pixel art cabem numa paleta: o atlas vira índices de 1 byte e ganha as variantes de cor
+    vector<unsigned char> indices, paleta;
+    int cores = indexarCores(pixels.data(), largura * altura, 4, indices, paleta);
+    atlas.linhasPaleta = cores > 0 ? LINHAS_PALETA_ATLAS : 1;
+    if (cores > 0)
     {
-        teclas[tecla] = false;
+        gerarVariantesPaleta(paleta, atlas.linhasPaleta);
+        printf("Atlas indexado: %d cores, %d variantes, %d KB (RGBA seria %d KB)\n", cores, atlas.linhasPaleta,
+               (int)(largura * altura + paleta.size()) / 1024, largura * altura * 4 / 1024);
     }
-}
-
-// Configura e compila os shaders
-int configurarShader()
-{
-    // Cria e compila o vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &codigoFonteVertexShader, NULL);
-    glCompileShader(vertexShader);
 
-    // Verifica erros de compilação
-    GLint sucesso;
-    GLchar infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &sucesso);
-
-
-    // Cria e compila o fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &sucesso);
-
-
-    // Cria o programa de shader e vincula os shaders
-    GLuint programaShader = glCreateProgram();
-    glAttachShader(programaShader, vertexShader);
-    glAttachShader(programaShader, fragmentShader);
-    glLinkProgram(programaShader);
-    glGetProgramiv(programaShader, GL_LINK_STATUS, &sucesso);
-
-    // Limpa os shaders depois de vinculados
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    // Envia o atlas para a GPU (ou para a memória do rasterizador no modo software)
+    atlas.largura = largura;
+    atlas.altura = altura;
+    if (renderSoftware)
+    {
+        if (cores > 0)
+            atlas.idTextura = rasterizador.criarTexturaIndexada(indices, paleta, largura, altura, false);
+        else
+            atlas.idTextura = rasterizador.criarTextura(pixels.data(), largura, altura, 4, false);
+    }
+    else
+    {
+        // Sem mipmaps: os níveis reduzidos misturariam sprites vizinhos (a borda é de 1 pixel)
+        if (cores > 0)
+            atlas.idTextura = criarTexturaIndexada(indices, paleta, largura, altura, GL_CLAMP_TO_EDGE);
+        else
+            atlas.idTextura = criarTextura2D(pixels.data(), largura, altura, 4, GL_CLAMP_TO_EDGE, GL_NEAREST, SEM_MIPMAPS);
+    }
 
-    return programaShader;
+    int areaSprites = 0;
+    for (size_t i = 0; i < atlas.entradas.size(); i++)
+        areaSprites += atlas.entradas[i].largura * atlas.entradas[i].altura;
+    printf("Atlas %dx%d: %d sprites, ocupacao %.1f%% (%.1f%% com bordas)\n", largura, altura,
+           (int)atlas.entradas.size(), 100.0f * areaSprites / (largura * altura),
+           100.0f * empacotador.areaUsada / (largura * altura));
+    return true;
 }
 
-// Configura um sprite com VAO e VBO
-int configurarSprite(int numAnimacoes, int numQuadros, float &ds, float &dt)
+// Faz o sprite usar uma entrada do atlas em vez de uma textura própria
+void aplicarEntradaAtlas(Sprite &sprite, int entrada)
 {
-    // Calcula deslocamento de textura para animação
-    ds = 1.0 / (float)numQuadros;
-    dt = 1.0 / (float)numAnimacoes;
-
-    // Define os vértices do quadrado 
-    GLfloat vertices[] = {
-        // x    y    s     t
-        -0.5,  0.5, 0.0,  dt, // Topo esquerdo
-        -0.5, -0.5, 0.0, 0.0, // Base esquerda
-         0.5,  0.5,  ds,  dt, // Topo direito
-        -0.5, -0.5, 0.0, 0.0, // Base esquerda 
-         0.5, -0.5,  ds, 0.0, // Base direita
-         0.5,  0.5,  ds, dt}; // Topo direito 
-
-    // Cria e configura o VBO
-    GLuint VBO, VAO;
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // Cria e configura o VAO
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-    // Atributo 0 - Posição
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid *)0);
-    glEnableVertexAttribArray(0);
-    // Atributo 1 - Coordenadas de textura
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid *)(2 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
-    // Desvincula buffers
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    return VAO;
+    sprite.idTextura = atlasSprites.idTextura;
+    sprite.uvAtlas = atlasSprites.entradas[entrada].uv;
+    sprite.entradaAtlas = entrada;
+    sprite.translucido = atlasSprites.entradas[entrada].translucida;
 }
 
-// Reinicia o jogo para o estado inicial
-void reiniciarJogo()
+// Registra que uma entrada do atlas foi desenhada no frame (para contar os binds evitados)
+void marcarEntradaAtlasUsada(int entrada)
 {
-    estadoJogo = MENU;                   // Volta para o menu
-    jogador.posicao = vec3(300, 100, 0); // Reposiciona jogador
-    // Remove todos os inimigos
-    for (int j = 0; j < MAX_INIMIGOS; j++)
-    {
-        inimigos[j].posicao = vec3(-100.0f, -100.0f, 0.0f);
-    }
-    temporizadorAparecerInimigos = 0.0f; // Reseta temporizador
+    if (entrada >= 0 && entrada < MAX_ENTRADAS_ATLAS)
+        entradasAtlasUsadas[entrada] = true;
 }
 
-// Desenha um sprite na tela
-void drawSprite(GLuint idShader, Sprite sprite, bool usarCorSolida)
+// Fecha a contagem do frame: sem atlas cada sprite distinto seria uma troca de textura
+void contarBindsEvitadosAtlas()
 {
-    // Define se usa cor sólida ou textura
-    glUniform1i(glGetUniformLocation(idShader, "useSolidColor"), usarCorSolida ? GL_TRUE : GL_FALSE);
-    glBindVertexArray(sprite.VAO); // usa cor sólida se não tiver textura
-    if (!usarCorSolida)
+    int entradasDesenhadas = 0;
+    for (int i = 0; i < MAX_ENTRADAS_ATLAS; i++)
     {
-        glBindTexture(GL_TEXTURE_2D, sprite.idTextura); // Vincula textura se não for cor sólida
+        if (entradasAtlasUsadas[i])
+            entradasDesenhadas++;
+        entradasAtlasUsadas[i] = false;
     }
-    // Calcula matriz de modelo (posição, escala)
-    mat4 modelo = mat4(1);
-    modelo = translate(modelo, sprite.posicao);
-    modelo = scale(modelo, sprite.dimensoes);
-    // Passa matriz para o shader
-    glUniformMatrix4fv(glGetUniformLocation(idShader, "model"), 1, GL_FALSE, value_ptr(modelo));
-    // Desenha os triângulos
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0); // Desvincula VAO
+    contadorBindsEvitadosAtlas = entradasDesenhadas > 1 ? entradasDesenhadas - 1 : 0;
 }
 
-// Carrega uma textura de arquivo
-int carregarTextura(string caminhoArquivo)
+// Função principal
+// Lê as opções da linha de comando:
+//   --headless         desenha sem janela (plataforma nula do GLFW, contexto EGL sem superfície ou OSMesa)
+//   --frames N         no modo headless, sai depois de N frames
+//   --saida arq.png    no modo headless, grava o último frame em PNG
+//   --software         desenha na CPU (automático sem OpenGL 4.0)
+//   --threads N        threads do rasterizador em software (padrão: uma por núcleo)
+//   --capturar N       grava os N primeiros frames desenhados como clipe (PNG por frame, como a tecla K)
+//   --video arq        grava o vídeo da sessão no relógio virtual ("-" = saída padrão, para um pipe)
+//   --video-formato F  y4m (YUV 4:2:0) ou rgba (cru, de cima para baixo); padrão pela extensão, senão y4m
+//   --video-fps N      frames por segundo do vídeo e passo do relógio virtual (padrão 60)
+//   --semente N        semente do rand() (padrão: relógio; no relógio virtual, SEMENTE_VIDEO)
+//   --relogio-virtual  a simulação anda 1/fps por frame (como no vídeo): os mesmos argumentos desenham os mesmos frames
+//   --comparar arq.png no modo headless, compara o último frame com arq.png (implica --relogio-virtual) e sai
+//                      com erro se diferir. Confere o rasterizador em software contra o OpenGL:
+//                        --headless --relogio-virtual --frames 240 --saida gpu.png
+//                        --headless --software --frames 240 --comparar gpu.png
+bool lerArgumentos(int argc, char **argv)
 {
-    GLuint idTextura;
-    glGenTextures(1, &idTextura); // Gera ID da textura
-    glBindTexture(GL_TEXTURE_2D, idTextura);
-
-    // Configura parâmetros da textura
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-    // Carrega imagem do arquivo
-    int largura, altura, nrCanais;
-    unsigned char *dados = stbi_load(caminhoArquivo.c_str(), &largura, &altura, &nrCanais, 0);
-
-    if (dados)
+    for (int i = 1; i < argc; i++)
     {
-        // Carrega dados na GPU baseado no número de canais (RGB ou RGBA)
-        if (nrCanais == 3)
-        {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, largura, altura, 0, GL_RGB, GL_UNSIGNED_BYTE, dados);
-        }
+        string argumento = argv[i];
+        if (argumento == "--headless")
+            modoHeadless = true;
+        else if (argumento == "--frames" && i + 1 < argc)
+            framesHeadless = atoi(argv[++i]);
+        else if (argumento == "--saida" && i + 1 < argc)
+            arquivoSaidaHeadless = argv[++i];
+        else if (argumento == "--software")
+            renderSoftware = true;
+        else if (argumento == "--threads" && i + 1 < argc)
+            threadsSoftware = atoi(argv[++i]);
+        else if (argumento == "--capturar" && i + 1 < argc)
+            quadrosClipeArgumento = atoi(argv[++i]);
+        else if (argumento == "--video" && i + 1 < argc)
+            arquivoVideo = argv[++i];
+        else if (argumento == "--video-formato" && i + 1 < argc)
+            formatoVideo = argv[++i];
+        else if (argumento == "--video-fps" && i + 1 < argc)
+            fpsVideo = atoi(argv[++i]);
+        else if (argumento == "--semente" && i + 1 < argc)
+            sementeAleatoria = strtoul(argv[++i], nullptr, 10);
+        else if (argumento == "--relogio-virtual")
+            relogioVirtual = true;
+        else if (argumento == "--comparar" && i + 1 < argc)
+            arquivoComparacao = argv[++i];
         else
         {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, largura, altura, 0, GL_RGBA, GL_UNSIGNED_BYTE, dados);
+            cerr << "Argumento desconhecido: " << argumento << endl;
+            cerr << "Uso: " << argv[0] << " [--headless] [--frames N] [--saida arquivo.png] [--software] [--threads N] [--capturar N]"
+                 << " [--video arquivo|-] [--video-formato y4m|rgba] [--video-fps N] [--semente N] [--relogio-virtual]"
+                 << " [--comparar referencia.png]" << endl;
+            return false;
         }
-        glGenerateMipmap(GL_TEXTURE_2D); 
     }
-    else
+    if (!arquivoComparacao.empty() && !modoHeadless)
     {
-        cout << "Falha ao carregar textura" << endl;
+        cerr << "--comparar precisa de --headless" << endl;
+        return false;
     }
+    if (!arquivoComparacao.empty() || !arquivoVideo.empty())
+        relogioVirtual = true; // Sem isso o frame comparado (ou gravado) dependeria da velocidade da máquina
+    if (framesHeadless <= 0)
+    {
+        cerr << "--frames precisa ser maior que zero" << endl;
+        return false;
+    }
+    if (quadrosClipeArgumento < 0)
+    {
+        cerr << "--capturar precisa ser maior que zero" << endl;
+        return false;
+    }
+    if (fpsVideo <= 0 || 1.0f / fpsVideo > DELTA_MAXIMO)
+    {
+        cerr << "--video-fps precisa ser pelo menos " << (int)ceilf(1.0f / DELTA_MAXIMO) << endl;
+        return false;
+    }
+    if (formatoVideo.empty())
+    {
+        size_t ponto = arquivoVideo.rfind('.');
+        string extensao = ponto == string::npos ? "" : arquivoVideo.substr(ponto + 1);
+        formatoVideo = extensao == "rgba" || extensao == "raw" ? "rgba" : "y4m";
+    }
+    if (formatoVideo != "y4m" && formatoVideo != "rgba")
+    {
+        cerr << "--video-formato precisa ser y4m ou rgba" << endl;
+        return false;
+    }
+    return true;
+}
 
-    // Libera memória da imagem
-    stbi_image_free(dados);
-    glBindTexture(GL_TEXTURE_2D, 0); // Desvincula textura
-
-    return idTextura;
+// Cria o contexto do modo headless. Na plataforma nula do GLFW a "janela" nunca aparece; o contexto vem
+// do EGL sem superfície (Mesa, drivers com EGL_MESA_platform_surfaceless) ou, se não houver, do OSMesa.
+// O jogo desenha sempre no alvo interno, então o framebuffer padrão não é necessário.
+// Sem nenhum dos dois (ou com --software) cria a janela sem contexto e desenha na CPU.
+GLFWwindow *criarJanelaHeadless()
+{
+    const int APIS_CONTEXTO[] = {GLFW_EGL_CONTEXT_API, GLFW_OSMESA_CONTEXT_API};
+    const char *NOMES_APIS[] = {"EGL sem superficie", "OSMesa"};
+    for (int i = 0; i < 2 && !renderSoftware; i++)
+    {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, APIS_CONTEXTO[i]);
+        GLFWwindow *criada = glfwCreateWindow(LARGURA, ALTURA, "Meu Jogo", nullptr, nullptr);
+        if (criada)
+        {
+            printf("Headless: contexto %s\n", NOMES_APIS[i]);
+            return criada;
+        }
+    }
+    if (!renderSoftware)
+        cerr << "Headless: sem contexto OpenGL, usando o rasterizador em software" << endl;
+    renderSoftware = true;
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    return glfwCreateWindow(LARGURA, ALTURA, "Meu Jogo", nullptr, nullptr);
 }
 
-// Função principal
-int main()
+int main(int argc, char **argv)
 {
-    // Inicializa GLFW
-    glfwInit();
-    glfwWindowHint(GLFW_SAMPLES, 8); // Habilita anti-aliasing
+    if (!lerArgumentos(argc, argv))
+        return -1;
+
+    // Vídeo: abre antes de qualquer mensagem (com "-" a saída padrão passa a ser o vídeo)
+    if (!arquivoVideo.empty() && !gravador.abrir(arquivoVideo, formatoVideo == "y4m", fpsVideo))
+        return -1;
+
+    // Inicializa GLFW (sem janela: plataforma nula, que não precisa de servidor gráfico)
+    if (modoHeadless)
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    if (!glfwInit())
+    {
+        cerr << "Falha ao inicializar o GLFW" << endl;
+        return -1;
+    }
+    glfwWindowHint(GLFW_SAMPLES, 0);    // O MSAA fica no alvo interno, controlado pelo governador
+    glfwWindowHint(GLFW_DEPTH_BITS, 0); // A janela só recebe a imagem final; a profundidade fica no alvo
 
     // Inicializa array de teclas
     for (int i = 0; i < 1024; i++)
@@ -557,105 +4866,251 @@ int main()
         teclas[i] = false;
     }
 
-    // Inicializa gerador de números aleatórios
-    srand(static_cast<unsigned int>(time(nullptr)));
+    // Inicializa gerador de números aleatórios (semente fixa no relógio virtual: a mesma execução sai igual)
+    if (sementeAleatoria < 0 && relogioVirtual)
+        sementeAleatoria = SEMENTE_VIDEO;
+    srand(sementeAleatoria >= 0 ? (unsigned int)sementeAleatoria : static_cast<unsigned int>(time(nullptr)));
 
     // Cria janela GLFW
-    janela = glfwCreateWindow(LARGURA, ALTURA, "Meu Jogo", nullptr, nullptr);
+    janela = modoHeadless ? criarJanelaHeadless() : glfwCreateWindow(LARGURA, ALTURA, "Meu Jogo", nullptr, nullptr);
     if (!janela)
     {
-        cerr << "Falha ao criar a janela GLFW" << endl;
+        cerr << (modoHeadless ? "Falha ao criar a janela headless" : "Falha ao criar a janela GLFW (sem OpenGL: use --headless --software)") << endl;
         glfwTerminate();
         return -1;
     }
-    glfwMakeContextCurrent(janela);
+    bool temContextoGL = !(modoHeadless && renderSoftware); // Headless em software não cria contexto
+    if (temContextoGL)
+        glfwMakeContextCurrent(janela);
     // Configura callbacks
     glfwSetKeyCallback(janela, tecladoCallbackMenu);
     glfwSetMouseButtonCallback(janela, mouseCallbackMenu);
+    glfwSetFramebufferSizeCallback(janela, redimensionarCallback);
+    glfwSetCursorPosCallback(janela, cursorCallbackMenu);
+    glfwSetWindowRefreshCallback(janela, redesenharCallback);
 
     // Inicializa GLAD (carrega funções OpenGL)
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    if (temContextoGL && !gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
     {
         cerr << "Falha ao inicializar GLAD" << endl;
         return -1;
     }
+    if (!renderSoftware && !versaoGLMinima(4, 0))
+    {
+        // O contexto serve só para mostrar a imagem (glDrawPixels existe desde o OpenGL 1.0)
+        cerr << "OpenGL " << GLVersion.major << "." << GLVersion.minor << " sem suporte a 4.0: usando o rasterizador em software" << endl;
+        renderSoftware = true;
+    }
+    if (!renderSoftware)
+        carregarExtensoesGL();
 
-    // Configura viewport
-    int largura, altura;
-    glfwGetFramebufferSize(janela, &largura, &altura);
-    glViewport(0, 0, largura, altura);
+    // Cria o alvo interno no nível de qualidade inicial (o viewport é definido a cada frame)
+    glfwGetFramebufferSize(janela, &larguraFramebuffer, &alturaFramebuffer);
+    if (renderSoftware)
+    {
+        rasterizador.iniciar(threadsSoftware > 0 ? threadsSoftware : (int)thread::hardware_concurrency());
+        printf("Rasterizador em software: %d threads, %s\n", rasterizador.numThreads, NOME_SIMD_RASTERIZADOR);
+    }
+    else
+    {
+        glGenQueries(2, governador.consultasTempo);
+    }
+    aplicarNivelQualidade(NIVEL_QUALIDADE_INICIAL);
+    if (!renderSoftware)
+    {
+        programaApresentacao = configurarShader(codigoFonteVertexApresentacao, codigoFonteFragmentApresentacao);
+        programaApresentacao.definir(programaApresentacao.uniforme<int>("tex_buff"), 0);
+        glGenVertexArrays(1, &VAOApresentacao);
+
+        // As texturas carregadas a seguir são enviadas por este buffer
+        bufferEnvioTexturas.criar(GL_PIXEL_UNPACK_BUFFER, BYTES_ENVIO_TEXTURAS);
+
+        // Compila de antemão as variantes de shader usadas pelo jogo (as demais compilam no primeiro uso)
+        varianteShader<SPRITE_COR_SOLIDA>();
+        varianteShader<SPRITE_ANIMADO | RECURSO_INSTANCIADO | RECURSO_RECORTE>();
+        varianteShader<SPRITE_ANIMADO | RECURSO_INSTANCIADO | RECURSO_RECORTE | RECURSO_PALETA>(); // Atlas indexado
+        varianteShader<SPRITE_ROLAGEM | RECURSO_INSTANCIADO | RECURSO_RECORTE>();
+        printf("Programas de shader: %d do cache, %d compilados, %.1f ms%s\n", programasDoCache, programasCompilados,
+               tempoProgramasMs, pglProgramBinary ? "" : " (driver sem binarios de programa)");
+    }
 
-    // Configura shaders
-    GLuint idShader = configurarShader();
+    // Configuração do fundo: a estrada rola na velocidade do jogo. Outras camadas de parallax entram
+    // aqui, da mais distante para a mais próxima (até MAX_CAMADAS_FUNDO)
+    bool estradaTranslucida = false;
+    GLuint texturaEstrada = carregarTextura("../assets/tex/1.png", &estradaTranslucida);
+    adicionarCamadaFundo(texturaEstrada, vec2(0.0f, 1.0f), estradaTranslucida);
 
-    // Configuração do fundo
-    fundo.VAO = configurarSprite(1, 1, fundo.ds, fundo.dt);
-    fundo.idTextura = carregarTextura("../assets/tex/1.png");
-    fundo.posicao = vec3(400, 300, 0);   // Centro da tela
-    fundo.dimensoes = vec3(800, 600, 1); // Cobre toda a tela
-    fundo.angulo = 0.0;
+    // Empacota os sprites em um atlas. Se falhar (imagem faltando) o erro já foi mostrado e os sprites
+    // saem pretos, como os de uma textura que não carregou
+    vector<string> spritesAtlas(CAMINHOS_SPRITES_ATLAS, CAMINHOS_SPRITES_ATLAS + NUM_ENTRADAS_ATLAS_SPRITES);
+    construirAtlas(atlasSprites, spritesAtlas);
 
     // Configuração do jogador
-    jogador.VAO = configurarSprite(1, 1, jogador.ds, jogador.dt);
-    jogador.idTextura = carregarTextura("../assets/sprites/player.png");
-    jogador.posicao = vec3(300, 100, 0);            // Posição inicial
+    jogador.VAO = configurarSprite();
+    aplicarEntradaAtlas(jogador, ENTRADA_JOGADOR);
+    jogador.posicao = vec3(300, 100, PROFUNDIDADE_JOGADOR);            // Posição inicial
     jogador.dimensoes = vec3(100.0f, 100.0f, 1.0f); // Tamanho
     jogador.velocidade = 3.0;                       // Velocidade de movimento
     jogador.numAnimacoes = 1;                       // Sem animações
     jogador.numQuadros = 1;                         // Apenas 1 quadro
+    jogador.quadrosPorSegundo = QUADROS_POR_SEGUNDO_JOGADOR;
     jogador.angulo = 0.0;
     jogador.animacaoAtual = 0;
-    jogador.quadroAtual = 0;
 
-    // Inicializa inimigos
+    // Inicializa inimigos e a geometria compartilhada do desenho instanciado
     inicializarInimigos();
+    VAOInstancias = configurarSpriteInstanciado();
+
+    // Botões do menu (criados uma vez) e atlas da fonte do HUD
+    construirMenu();
+    fonteCarregada = carregarFonte(CAMINHO_FONTE);
+
+    // Projeção ortográfica, câmera e tempo ficam no uniform buffer compartilhado
+    criarConstantesFrame();
+
+    if (!renderSoftware)
+    {
+        // Configura blending e depth test
+        ativarBlend(true);
+        definirFuncaoBlend(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        ativarDepthTest(true);
+        definirFuncaoDepth(GL_LESS);
+
+        // Consultas que contam as amostras escritas (visualização de sobreposição)
+        glGenQueries(2, consultasFragmentos);
+    }
 
-    // Configura shader e textura
-    glUseProgram(idShader);
-    glActiveTexture(GL_TEXTURE0);
-    glUniform1i(glGetUniformLocation(idShader, "tex_buff"), 0);
+    // Capturas: as threads de PNG usam os núcleos que sobram (o laço e a GPU seguem sem esperar)
+    captura.iniciar(glm::clamp((int)thread::hardware_concurrency() - 1, 1, MAX_THREADS_CAPTURA));
+    if (quadrosClipeArgumento > 0)
+        alternarClipe();
 
-    // Configura matriz de projeção ortográfica do vertexshader
-    mat4 projecao = ortho(0.0, 800.0, 0.0, 600.0, -1.0, 1.0);
-    glUniformMatrix4fv(glGetUniformLocation(idShader, "projection"), 1, GL_FALSE, value_ptr(projecao));
+    // Ritmo do laço principal
+    agendador.intervalo = 1.0 / LIMITE_FPS;
+    agendador.semJanela = modoHeadless;
+    agendador.definirModo(modoHeadless ? RITMO_LIVRE : MODO_RITMO_INICIAL);
 
-    // Configura blending e depth test
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_ALWAYS);
+    // Headless mede a vazão: nível de qualidade fixo para os números serem comparáveis entre execuções.
+    // No vídeo o tamanho dos frames também não pode mudar.
+    if (modoHeadless || gravador.ativo())
+        governador.automatico = false;
+    int framesDesenhados = 0;
+    int codigoSaida = 0; // Diferente de zero se a comparação com a referência falhar
+    double inicioMedicao = glfwGetTime();
+    if (gravador.ativo())
+        printf("Video: %s (%s, %d fps no relogio virtual, semente %lld)\n", arquivoVideo.c_str(), formatoVideo.c_str(), fpsVideo, sementeAleatoria);
 
     // Variáveis para controle de tempo e FPS
-    double ultimoFrame = glfwGetTime();
-    double tempoInicial = glfwGetTime();
+    double ultimoFrame = relogioJogo();
+    double tempoInicial = relogioJogo();
 
     // Loop principal do jogo
     while (!glfwWindowShouldClose(janela))
     {
-        // Calcula delta time
-        double frameAtual = glfwGetTime();
-        float deltaTempo = static_cast<float>(frameAtual - ultimoFrame);
+        // Menu e fim de jogo são telas paradas: sem nada novo para mostrar, dorme até chegar um
+        // evento (ou o prazo do fim de jogo) em vez de redesenhar a mesma imagem a cada vsync.
+        // No relógio virtual todo frame é desenhado: ele só anda com os frames.
+        bool telaParada = estadoJogo != JOGANDO && !telaAlterada && !relogioVirtual;
+        if (telaParada)
+        {
+            double espera = ESPERA_MAXIMA_TELA_PARADA;
+            if (estadoJogo == FIM_DE_JOGO)
+                espera = std::max(0.0, TEMPO_FIM_DE_JOGO - (glfwGetTime() - instanteFimDeJogo));
+            glfwWaitEventsTimeout(espera);
+        }
+        else
+        {
+            // No modo baixa latência espera aqui, antes de ler a entrada
+            if (estadoJogo == JOGANDO)
+                agendador.antesDoFrame();
+            glfwPollEvents();
+        }
+
+        // Calcula delta time (limitado: o primeiro frame depois do menu não conta o tempo dormindo)
+        double frameAtual = relogioJogo();
+        float deltaTempo = std::min(static_cast<float>(frameAtual - ultimoFrame), DELTA_MAXIMO);
         ultimoFrame = frameAtual;
 
-        // Atualiza título da janela com FPS e tempo
-        double tempoAtual = glfwGetTime() - tempoInicial;
+        // Depois de 1 segundo no fim de jogo, volta para o menu (headless não espera e joga de novo)
+        if (estadoJogo == FIM_DE_JOGO && (modoHeadless || frameAtual - instanteFimDeJogo >= TEMPO_FIM_DE_JOGO))
+            reiniciarJogo();
+        if (modoHeadless && estadoJogo == MENU)
+            iniciarPartida();
+
+        // Tela parada sem mudanças: nada a desenhar nem apresentar (a imagem anterior continua na janela)
+        if (telaParada)
+            continue;
+        telaAlterada = false; // Mudanças durante este frame (ex.: batida) pedem outro desenho
+
+        // Monta o HUD com tempo, FPS, pontos e os contadores do frame anterior
+        double tempoAtual = relogioJogo() - tempoInicial;
         double fps = 1.0 / deltaTempo;
-        char tituloJanela[128];
-        sprintf(tituloJanela, "Tempo: %.1fs | FPS: %.1f", tempoAtual, fps);
-        glfwSetWindowTitle(janela, tituloJanela);
+        int pontos = (int)((distanciaEstrada - distanciaInicioPartida) * PONTOS_POR_TELA);
+        contarBindsEvitadosAtlas();
+        lerContagemFragmentos();
+        atualizarGovernador();
+        const int NUM_LINHAS_HUD = 6;
+        char linhasHud[NUM_LINHAS_HUD][160];
+        snprintf(linhasHud[0], 160, "Tempo: %.1fs   FPS: %.1f   Pontos: %d", tempoAtual, fps, pontos);
+        snprintf(linhasHud[1], 160, "Draws: %d (sem instancing: %d) [I: agrupar %s]   Uniforms: %d (evitados: %d)",
+                 contadorDrawCalls, contadorSpritesDesenhados, usarInstancing ? "ON" : "OFF",
+                 ProgramaShader::uniformsEnviados, ProgramaShader::uniformsEvitados);
+        snprintf(linhasHud[2], 160, "Binds evitados (atlas): %d   Estado GL: %d (evitadas: %d)   Esperas streaming: %d",
+                 contadorBindsEvitadosAtlas, estadoGL.chamadasEmitidas, estadoGL.chamadasEvitadas, bufferInstancias.esperasFence);
+        snprintf(linhasHud[3], 160, "Sobreposicao: %.2fx [P: profundidade %s, O: ver %s]",
+                 sobreposicaoMedia, usarCamadasProfundidade ? "ON" : "OFF", visualizarSobreposicao ? "ON" : "OFF");
+        snprintf(linhasHud[4], 160, "Qualidade: %s, %s %.2fms [Q: trocar, G: auto %s]",
+                 NIVEIS_QUALIDADE[governador.nivel].nome, renderSoftware ? "CPU" : "GPU", governador.mediaMs,
+                 governador.automatico ? "ON" : "OFF");
+        snprintf(linhasHud[5], 160, "Ritmo: %s, %.2fms +-%.2f (pior %.2f) [V]   Capturas: %d (fila %d) [C: tela, K: clipe %s]",
+                 NOMES_MODOS_RITMO[agendador.modo], agendador.mediaMs, agendador.desvioMs, agendador.piorMs,
+                 captura.gravados.load(), captura.imagensNaFila(), gravandoClipe ? "ON" : "OFF");
+        if (fonteCarregada)
+        {
+            // Texto na tela (entra no draw único do texto); nada de ida ao gerenciador de janelas por frame
+            vec4 corHud = vec4(1.0f, 1.0f, 0.6f, 1.0f);
+            vec4 corEstatisticas = vec4(0.85f, 0.85f, 0.85f, 0.9f);
+            escreverTexto(linhasHud[0], vec2(10.0f, ALTURA - 10.0f - TAMANHO_TEXTO_HUD), TAMANHO_TEXTO_HUD, corHud);
+            // Os contadores de desempenho mudam de uma execução para outra: ficam fora do relógio virtual
+            for (int i = 1; i < NUM_LINHAS_HUD && !relogioVirtual; i++)
+            {
+                float y = ALTURA - 16.0f - TAMANHO_TEXTO_HUD - i * TAMANHO_TEXTO_ESTATISTICAS * ESPACAMENTO_LINHAS;
+                escreverTexto(linhasHud[i], vec2(10.0f, y), TAMANHO_TEXTO_ESTATISTICAS, corEstatisticas);
+            }
+        }
+        else
+        {
+            // Sem fonte: as mesmas informações no título da janela
+            string tituloJanela = linhasHud[0];
+            for (int i = 1; i < NUM_LINHAS_HUD; i++)
+                tituloJanela += string(" | ") + linhasHud[i];
+            glfwSetWindowTitle(janela, tituloJanela.c_str());
+        }
+        contadorDrawCalls = 0; // Reinicia os contadores do frame
+        contadorSpritesDesenhados = 0;
+        ProgramaShader::uniformsEnviados = 0;
+        ProgramaShader::uniformsEvitados = 0;
+        estadoGL.chamadasEmitidas = 0;
+        estadoGL.chamadasEvitadas = 0;
+        bufferInstancias.esperasFence = 0;
+
+        // A estrada só anda durante o jogo, acelerando junto com os inimigos; o shader rola o fundo a
+        // partir desta distância
+        if (estadoJogo == JOGANDO)
+            distanciaEstrada += VELOCIDADE_ESTRADA_BASE * (velocidadeJogo / VELOCIDADE_INIMIGO_BASE) * deltaTempo;
 
-        // Processa eventos
-        glfwPollEvents();
+        // Atualiza as constantes compartilhadas do frame
+        atualizarConstantesFrame(static_cast<float>(tempoAtual), deltaTempo);
 
-        // Limpa buffers
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Desenha no alvo interno; limpa buffers
+        iniciarFrameAlvo();
+        limparTela(vec4(0.0f, 0.0f, 0.0f, 1.0f), GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // Máquina de estados do jogo
         switch (estadoJogo)
         {
         case MENU:
-            renderizarMenu(idShader); // Desenha menu
+            renderizarMenu(); // Desenha menu
             break;
 
         case JOGANDO: //Configuração de teclas W,A,S,D e setas do teclado
@@ -685,35 +5140,23 @@ int main()
                     jogador.posicao.x = LARGURA - jogador.dimensoes.x / 2;
             }
 
-            // Desenha fundo
-            glUniform2f(glGetUniformLocation(idShader, "offset_tex"), 0.0, 0.0);
-            drawSprite(idShader, fundo);
+            // Inclina o carro para o lado da curva (a rotação é feita no shader)
+            float direcao = (float)(teclas[GLFW_KEY_RIGHT] || teclas[GLFW_KEY_D]) - (float)(teclas[GLFW_KEY_LEFT] || teclas[GLFW_KEY_A]);
+            float anguloAlvo = -direcao * ANGULO_CURVA_JOGADOR;
+            jogador.angulo += (anguloAlvo - jogador.angulo) * glm::min(1.0f, deltaTempo * RAPIDEZ_CURVA_JOGADOR);
 
-            // Atualiza e desenha inimigos
+            // Enfileira fundo, inimigos e jogador (a fila decide a ordem de envio)
+            enfileirarFundo();
             atualizarInimigos(deltaTempo);
-            drawInimigos(idShader);
-
-            // Desenha jogador
-            float ds = jogador.quadroAtual * jogador.ds;
-            float dt = jogador.animacaoAtual * jogador.dt;
-            glUniform2f(glGetUniformLocation(idShader, "offset_tex"), ds, dt);
-            drawSprite(idShader, jogador);
-
-            // Atualiza animação do jogador
-            float agora = glfwGetTime();
-            float deltaTempoAnim = agora - ultimoTempo;
-            if (deltaTempoAnim >= 1 / FPS)
-            {
-                jogador.quadroAtual = (jogador.quadroAtual + 1) % jogador.numQuadros;
-                ultimoTempo = agora;
-            }
+            drawInimigos();
+            enfileirarSprite<SPRITE_ANIMADO>(jogador, CAMADA_JOGADOR);
 
             // Verifica colisões se aconteceu da GAME OVER
             for (int i = 0; i < MAX_INIMIGOS; i++)
             {
                 if (inimigos[i].posicao.y > -50.0f && verificarColisao(jogador, inimigos[i]))
                 {
-                    estadoJogo = FIM_DE_JOGO; // Colisão detectada
+                    mudarEstadoJogo(FIM_DE_JOGO); // Colisão detectada
                     break;
                 }
             }
@@ -721,30 +5164,68 @@ int main()
         }
 
         case FIM_DE_JOGO:
-        {
-            // Temporizador para voltar ao menu após colisão
-            static float temporizadorFimJogo = 0.0f;
-            temporizadorFimJogo += deltaTempo;
-
-            // Desenha fundo
-            glUniform2f(glGetUniformLocation(idShader, "offset_tex"), 0.0, 0.0);
-            drawSprite(idShader, fundo);
-
-            // Depois de 1 segundo, volta para o menu
-            if (temporizadorFimJogo >= 1.0f)
-            {
-                reiniciarJogo();
-                temporizadorFimJogo = 0.0f;
-            }
+            // Desenha fundo (parado: a distância não avança depois da batida) e o carro batido, tingido
+            enfileirarFundo();
+            enfileirarSprite<SPRITE_ANIMADO>(jogador, CAMADA_JOGADOR);
             break;
         }
+
+        // Envia os desenhos enfileirados no frame e, por cima, todo o texto
+        submeterFilaRender();
+        desenharTextos();
+        apresentarAlvoRender();
+        capturarFrame();
+        bufferInstancias.fimDoFrame();
+        bufferTexto.fimDoFrame();
+        bufferEnvioTexturas.fimDoFrame();
+
+        // Troca buffers (no modo limitado espera o prazo antes)
+        agendador.antesDaApresentacao();
+        if (!modoHeadless)
+            glfwSwapBuffers(janela);
+        agendador.depoisDaApresentacao();
+
+        quadrosRelogioVirtual++;
+        if (modoHeadless && ++framesDesenhados >= framesHeadless)
+            glfwSetWindowShouldClose(janela, GL_TRUE);
+    }
+
+    // Headless: espera a GPU terminar, mostra a vazão medida e grava o último frame
+    if (modoHeadless)
+    {
+        string renderizador = "software (" + to_string(rasterizador.numThreads) + " threads, " + NOME_SIMD_RASTERIZADOR + ")";
+        if (!renderSoftware)
+        {
+            glFinish();
+            renderizador = (const char *)glGetString(GL_RENDERER);
         }
+        double segundos = glfwGetTime() - inicioMedicao;
+        printf("Headless: %d frames em %.2fs = %.1f FPS (%.3f ms/frame), %s %.3f ms/frame, qualidade %s, %s\n",
+               framesDesenhados, segundos, framesDesenhados / segundos, segundos * 1000.0 / framesDesenhados,
+               renderSoftware ? "CPU" : "GPU", governador.mediaMs, NIVEIS_QUALIDADE[governador.nivel].nome, renderizador.c_str());
+        if (!arquivoSaidaHeadless.empty())
+            salvarImagemAlvo(arquivoSaidaHeadless);
+        if (!arquivoComparacao.empty() && !compararImagemAlvo(arquivoComparacao))
+            codigoSaida = 1;
+    }
 
-        // Troca buffers e verifica eventos
-        glfwSwapBuffers(janela);
+    // Termina o vídeo e as capturas pendentes (ainda com o contexto GL) antes de sair
+    if (gravador.ativo())
+    {
+        gravador.fechar();
+        printf("Video: %d frames %dx%d gravados, %d esperas pela escrita, %d frames de outro tamanho ignorados\n",
+               gravador.gravados.load(), gravador.largura, gravador.altura, gravador.esperasFila, gravador.descartados);
     }
+    if (gravandoClipe)
+        alternarClipe();
+    captura.encerrar();
+    if (captura.gravados > 0)
+        printf("Capturas: %d PNGs gravados, %d esperas de fence, %d frames descartados (fila cheia)\n",
+               captura.gravados.load(), captura.anel.esperasFence, captura.descartados);
+    if (renderSoftware)
+        rasterizador.encerrar();
 
     // Finaliza GLFW
     glfwTerminate();
-    return 0;
+    return codigoSaida;
 }
\ No newline at end of file